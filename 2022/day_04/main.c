@@ -5,6 +5,7 @@
 
 #include "array.h"
 #include "helpers.h"
+#include "intervals.h"
 
 int usage(const char *name) {
     printf("usage: %s input\n", name);
@@ -13,20 +14,11 @@ int usage(const char *name) {
 }
 
 typedef struct {
-    int start, end;
-} pair;
-
-typedef struct {
-    pair left, right;
+    interval_t left, right;
 } assignment;
 
 ARRAY(assignment, assignment_array)
 
-static inline bool contains(pair a, pair b) { return b.start >= a.start and b.end <= a.end; }
-static inline bool overlaps(pair a, pair b) {
-    return (b.start >= a.start and b.start <= a.end) or (b.end >= a.start and b.end <= a.end);
-}
-
 int main(int argc, char *argv[]) {
     if (argc - 1 != 1) {
         return usage(argv[0]);
@@ -48,8 +40,9 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
-        assignment pairs;
-        sscanf(line, "%d-%d,%d-%d\n", &pairs.left.start, &pairs.left.end, &pairs.right.start, &pairs.right.end);
+        int left_start = 0, left_end = 0, right_start = 0, right_end = 0;
+        sscanf(line, "%d-%d,%d-%d\n", &left_start, &left_end, &right_start, &right_end);
+        assignment pairs = {interval(left_start, left_end), interval(right_start, right_end)};
         if (not assignment_array_append(&assignments, pairs)) {
             fprintf(stderr, "could not reallocate %ld bytes: %s\n", assignments.len * sizeof(assignment),
                     strerror(errno));
@@ -62,8 +55,8 @@ int main(int argc, char *argv[]) {
         printf("In how many assignment pairs does one range fully contain the other?\n");
         int count = 0;
         for (size_t i = 0; i < assignments.len; ++i) {
-            if (contains(assignments.data[i].left, assignments.data[i].right) or
-                contains(assignments.data[i].right, assignments.data[i].left)) {
+            if (interval_contains(assignments.data[i].left, assignments.data[i].right) or
+                interval_contains(assignments.data[i].right, assignments.data[i].left)) {
                 count++;
             }
         }
@@ -74,8 +67,7 @@ int main(int argc, char *argv[]) {
         printf("In how many assignment pairs do the ranges overlap?\n");
         int count = 0;
         for (size_t i = 0; i < assignments.len; ++i) {
-            if (overlaps(assignments.data[i].left, assignments.data[i].right) or
-                overlaps(assignments.data[i].right, assignments.data[i].left)) {
+            if (interval_overlaps(assignments.data[i].left, assignments.data[i].right)) {
                 count++;
             }
         }
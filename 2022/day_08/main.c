@@ -1,21 +1,161 @@
 #include <errno.h>
 #include <iso646.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
-#include "array.h"
 #include "helpers.h"
+#include "mapped.h"
+#include "stack.h"
 
-ARRAY(int, int_array)
-ARRAY(size_t, size_t_array)
+typedef struct {
+    const uint8_t *heights;
+    size_t rows, cols, stride;
+} forest_t;
+
+typedef struct {
+    uint64_t *words;
+    size_t row_words;
+} bitmap_t;
+
+static inline void bitmap_set(bitmap_t *bitmap, size_t i, size_t j) {
+    bitmap->words[j / 64 + i * bitmap->row_words] |= UINT64_C(1) << (j % 64);
+}
 
 typedef struct {
-    size_t up, right, down, left;
-} view_t;
+    const forest_t *forest;
+    bitmap_t *visibility;
+    size_t begin, end;
+} band_t;
+
+void *sweep_rows(void *arg) {
+    band_t *band = arg;
+    const forest_t *forest = band->forest;
+
+    for (size_t i = band->begin; i < band->end; ++i) {
+        const uint8_t *row = forest->heights + i * forest->stride;
+
+        uint8_t highest = 0;
+        for (size_t j = 0; j < forest->cols and highest != '9'; ++j) {
+            if (row[j] > highest) {
+                bitmap_set(band->visibility, i, j);
+                highest = row[j];
+            }
+        }
+
+        highest = 0;
+        for (size_t j = forest->cols; j-- > 0 and highest != '9';) {
+            if (row[j] > highest) {
+                bitmap_set(band->visibility, i, j);
+                highest = row[j];
+            }
+        }
+    }
+
+    return NULL;
+}
+
+typedef uint8_t u8x16 __attribute__((vector_size(16)));
+
+static inline bool u8x16_any(u8x16 v) {
+    uint64_t halves[2];
+    memcpy(halves, &v, sizeof(halves));
+    return (halves[0] | halves[1]) != 0;
+}
+
+static inline bool u8x16_all(u8x16 v) {
+    uint64_t halves[2];
+    memcpy(halves, &v, sizeof(halves));
+    return (halves[0] & halves[1]) == UINT64_MAX;
+}
+
+void sweep_block(const forest_t *forest, bitmap_t *visibility, size_t j, bool downwards) {
+    const u8x16 tallest = {'9', '9', '9', '9', '9', '9', '9', '9', '9', '9', '9', '9', '9', '9', '9', '9'};
+
+    u8x16 highest = {0};
+    for (size_t k = 0; k < forest->rows; ++k) {
+        size_t i = downwards ? k : forest->rows - 1 - k;
+
+        u8x16 heights;
+        memcpy(&heights, forest->heights + j + i * forest->stride, sizeof(heights));
+
+        u8x16 visible = (u8x16)(heights > highest);
+        if (u8x16_any(visible)) {
+            for (size_t lane = 0; lane < 16; ++lane) {
+                if (visible[lane]) {
+                    bitmap_set(visibility, i, j + lane);
+                }
+            }
+            highest = (heights & visible) | (highest & ~visible);
+        }
+
+        if (u8x16_all((u8x16)(highest == tallest))) {
+            break;
+        }
+    }
+}
 
-static inline size_t scenic_score(view_t view) { return view.up * view.right * view.down * view.left; }
+void sweep_column(const forest_t *forest, bitmap_t *visibility, size_t j, bool downwards) {
+    uint8_t highest = 0;
+    for (size_t k = 0; k < forest->rows and highest != '9'; ++k) {
+        size_t i = downwards ? k : forest->rows - 1 - k;
+        uint8_t height = forest->heights[j + i * forest->stride];
+        if (height > highest) {
+            bitmap_set(visibility, i, j);
+            highest = height;
+        }
+    }
+}
+
+void *sweep_columns(void *arg) {
+    band_t *band = arg;
+
+    size_t j = band->begin;
+    for (; j + 16 <= band->end; j += 16) {
+        sweep_block(band->forest, band->visibility, j, true);
+        sweep_block(band->forest, band->visibility, j, false);
+    }
+    for (; j < band->end; ++j) {
+        sweep_column(band->forest, band->visibility, j, true);
+        sweep_column(band->forest, band->visibility, j, false);
+    }
+
+    return NULL;
+}
+
+void run_bands(void *(*sweep)(void *), const forest_t *forest, bitmap_t *visibility, size_t n, size_t align,
+               size_t n_threads) {
+    size_t width = (n + n_threads - 1) / n_threads;
+    width = (width + align - 1) / align * align;
+
+    pthread_t *threads = calloc(n_threads, sizeof(pthread_t));
+    band_t *bands = calloc(n_threads, sizeof(band_t));
+    for (size_t t = 0; t < n_threads; ++t) {
+        size_t begin = t * width < n ? t * width : n, end = begin + width < n ? begin + width : n;
+        band_t band = {forest, visibility, begin, end};
+        bands[t] = band;
+        pthread_create(&threads[t], NULL, sweep, &bands[t]);
+    }
+    for (size_t t = 0; t < n_threads; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+
+    free(bands);
+    free(threads);
+}
+
+STACK(size_t, size_t_stack)
+
+// a tree whose view downwards is still open, partial is the product of its up, left and right viewing distances
+typedef struct {
+    size_t row;
+    uint8_t height;
+    size_t partial;
+} pending_t;
 
-ARRAY(view_t, view_t_array)
+STACK(pending_t, pending_t_stack)
 
 int usage(const char *name) {
     printf("usage: %s input\n", name);
@@ -35,175 +175,118 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
-    char *line = NULL;
-    size_t len = 0;
-
-    size_t rows = 0, cols = 0;
-    int_array heights = {0, 0, NULL};
-    while (getline(&line, &len, fptr) != -1) {
-        if (strequ(line, "\n")) {
-            continue;
-        }
-
-        if (not(strlen(line) - 1 > 0)) {
-            continue;
-        }
-
-        if (cols == 0) {
-            cols = strlen(line) - 1;
-        }
-
-        for (char *c = line; *c != '\n'; ++c) {
-            if (*c < '0' or *c > '9') {
-                continue;
-            }
-            int_array_append(&heights, *c - '0');
-        }
+    mapped_t mapped = mapped_open(fptr);
+    if (not mapped.data) {
+        fprintf(stderr, "could not read %s: %s\n", input, strerror(errno));
+        return EXIT_FAILURE;
+    }
 
-        ++rows;
+    forest_t forest = {(const uint8_t *)mapped.data, 0, 0, 0};
+    const char *newline = memchr(mapped.data, '\n', mapped.len);
+    forest.cols = newline ? (size_t)(newline - mapped.data) : mapped.len;
+    forest.stride = forest.cols + 1;
+    while (forest.cols > 0 and forest.rows * forest.stride + forest.cols <= mapped.len and
+           mapped.data[forest.rows * forest.stride] != '\n') {
+        ++forest.rows;
     }
 
     {
         printf("--- Part One ---\n");
         printf("Consider your map; how many trees are visible from outside the grid?\n");
 
-        size_t_array visibility = {0, 0, NULL};
-        for (size_t i = 0; i < rows; ++i) {
-            for (size_t j = 0; j < cols; ++j) {
-                size_t_array_append(&visibility, (i == 0 or i == rows - 1 or j == 0 or j == cols - 1) ? 1 : 0);
-            }
-        }
-
-        for (size_t i = 1; i < rows - 1; ++i) {
-            int highest = heights.data[0 + i * cols];
-            for (size_t j = 1; j < cols - 1; ++j) {
-                int height = heights.data[j + i * cols];
-                if (height > highest) {
-                    visibility.data[j + i * cols] = 1;
-                    highest = height;
-                }
+        long n_processors = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t n_threads = n_processors > 0 ? (size_t)n_processors : 1;
 
-                if (height == 9) {
-                    break;
-                }
-            }
-        }
+        bitmap_t visibility = {NULL, (forest.cols + 63) / 64};
+        visibility.words = calloc(forest.rows * visibility.row_words, sizeof(uint64_t));
 
-        for (size_t i = 1; i < rows - 1; ++i) {
-            int highest = heights.data[(cols - 1 - 0) + i * cols];
-            for (size_t j = 1; j < cols - 1; ++j) {
-                int height = heights.data[(cols - 1 - j) + i * cols];
-                if (height > highest) {
-                    visibility.data[(cols - 1 - j) + i * cols] = 1;
-                    highest = height;
-                }
-
-                if (height == 9) {
-                    break;
-                }
-            }
-        }
-
-        for (size_t j = 1; j < cols - 1; ++j) {
-            int highest = heights.data[j + 0 * cols];
-            for (size_t i = 1; i < rows - 1; ++i) {
-                int height = heights.data[j + i * cols];
-                if (height > highest) {
-                    visibility.data[j + i * cols] = 1;
-                    highest = height;
-                }
-
-                if (height == 9) {
-                    break;
-                }
-            }
-        }
-
-        for (size_t j = 1; j < cols - 1; ++j) {
-            int highest = heights.data[j + (rows - 1 - 0) * cols];
-            for (size_t i = 1; i < rows - 1; ++i) {
-                int height = heights.data[j + (rows - 1 - i) * cols];
-                if (height > highest) {
-                    visibility.data[j + (rows - 1 - i) * cols] = 1;
-                    highest = height;
-                }
-
-                if (height == 9) {
-                    break;
-                }
-            }
-        }
+        run_bands(sweep_rows, &forest, &visibility, forest.rows, 1, n_threads);
+        run_bands(sweep_columns, &forest, &visibility, forest.cols, 64, n_threads);
 
         size_t visible = 0;
-        for (size_t i = 0; i < rows; ++i) {
-            for (size_t j = 0; j < cols; ++j) {
-                visible += visibility.data[j + i * cols];
-            }
+        for (size_t i = 0; i < forest.rows * visibility.row_words; ++i) {
+            visible += (size_t)__builtin_popcountll(visibility.words[i]);
         }
         printf("%zu trees are visible from outside the grid.\n", visible);
 
-        size_t_array_free(&visibility);
+        free(visibility.words);
     }
 
     {
         printf("--- Part Two ---\n");
         printf("Consider each tree on your map. What is the highest scenic score possible for any tree?\n");
 
-        view_t_array views = {0, 0, NULL};
-        for (size_t i = 0; i < rows; ++i) {
-            for (size_t j = 0; j < cols; ++j) {
-                int height = heights.data[j + i * cols];
-                view_t view = {0, 0, 0, 0};
-
-                for (int k = (int)i - 1; k >= 0; --k) {
-                    view.up++;
-                    if (heights.data[j + (size_t)k * cols] >= height) {
-                        break;
+        size_t_stack row = {0, 0, NULL};
+        pending_t_stack *columns = calloc(forest.cols, sizeof(pending_t_stack));
+        size_t *partials = calloc(forest.cols, sizeof(size_t));
+
+        size_t highest = 0;
+        for (size_t i = 0; i < forest.rows; ++i) {
+            const uint8_t *line_heights = forest.heights + i * forest.stride;
+
+            row.len = 0;
+            for (size_t j = 0; j < forest.cols; ++j) {
+                size_t left = j;
+                while (row.len > 0 and line_heights[size_t_stack_top(&row)] <= line_heights[j]) {
+                    size_t k = size_t_stack_pop(&row);
+                    partials[k] *= j - k;
+                    if (line_heights[k] == line_heights[j]) {
+                        left = j - k;
                     }
                 }
-
-                for (int k = (int)j + 1; k < (int)cols; ++k) {
-                    view.right++;
-                    if (heights.data[(size_t)k + i * cols] >= height) {
-                        break;
-                    }
+                if (left == j and row.len > 0) {
+                    left = j - size_t_stack_top(&row);
                 }
+                partials[j] = left;
+                size_t_stack_push(&row, j);
+            }
+            while (row.len > 0) {
+                size_t k = size_t_stack_pop(&row);
+                partials[k] *= forest.cols - 1 - k;
+            }
 
-                for (int k = (int)i + 1; k < (int)rows; ++k) {
-                    view.down++;
-                    if (heights.data[j + (size_t)k * cols] >= height) {
-                        break;
-                    }
-                }
+            for (size_t j = 0; j < forest.cols; ++j) {
+                pending_t_stack *column = &columns[j];
+                uint8_t height = line_heights[j];
 
-                for (int k = (int)j - 1; k >= 0; --k) {
-                    view.left++;
-                    if (heights.data[(size_t)k + i * cols] >= height) {
-                        break;
+                size_t up = i;
+                while (column->len > 0 and pending_t_stack_top(column).height <= height) {
+                    pending_t pending = pending_t_stack_pop(column);
+                    if (pending.partial * (i - pending.row) > highest) {
+                        highest = pending.partial * (i - pending.row);
                     }
+                    if (pending.height == height) {
+                        up = i - pending.row;
+                    }
+                }
+                if (up == i and column->len > 0) {
+                    up = i - pending_t_stack_top(column).row;
                 }
 
-                view_t_array_append(&views, view);
+                pending_t pending = {i, height, partials[j] * up};
+                pending_t_stack_push(column, pending);
             }
         }
 
-        size_t score, highest = 0;
-        for (size_t i = 0; i < rows; ++i) {
-            for (size_t j = 0; j < cols; ++j) {
-                if ((score = scenic_score(views.data[j + i * cols])) > highest) {
-                    highest = score;
+        for (size_t j = 0; j < forest.cols; ++j) {
+            while (columns[j].len > 0) {
+                pending_t pending = pending_t_stack_pop(&columns[j]);
+                if (pending.partial * (forest.rows - 1 - pending.row) > highest) {
+                    highest = pending.partial * (forest.rows - 1 - pending.row);
                 }
             }
+            pending_t_stack_free(&columns[j]);
         }
 
         printf("The highest scenic score possible is %zu\n", highest);
 
-        view_t_array_free(&views);
+        free(partials);
+        free(columns);
+        size_t_stack_free(&row);
     }
 
-    int_array_free(&heights);
+    mapped_close(&mapped);
 
-    free(line);
     if (fptr != stdin) {
         fclose(fptr);
     }
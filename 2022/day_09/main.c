@@ -1,5 +1,7 @@
 #include <errno.h>
 #include <iso646.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -50,29 +52,152 @@ vec2i_t follow(vec2i_t head, vec2i_t tail) {
     return vec2i_add(tail, delta);
 }
 
-ARRAY(vec2i_t, vec2i_t_array)
+typedef struct {
+    vec2i_t origin;
+    uint64_t bits;
+} tile_t;
+
+typedef struct {
+    vec2i_t min, max;
+    size_t width;
+    uint64_t *words;
+    size_t tiles_cap, tiles_len;
+    tile_t *tiles;
+} visited_t;
+
+static const size_t dense_limit = (size_t)1 << 30;
+
+visited_t visited_new(vec2i_t min, vec2i_t max) {
+    visited_t visited = {min, max, 0, NULL, 0, 0, NULL};
+
+    size_t width = (size_t)((long)max.x - min.x + 1), height = (size_t)((long)max.y - min.y + 1);
+    if (width <= dense_limit / height) {
+        visited.width = width;
+        visited.words = calloc((width * height + 63) / 64, sizeof(uint64_t));
+    } else {
+        visited.tiles_cap = 1024;
+        visited.tiles = calloc(visited.tiles_cap, sizeof(tile_t));
+    }
+    return visited;
+}
+
+static inline size_t tile_hash(vec2i_t origin, size_t cap) {
+    uint64_t key = (uint64_t)(uint32_t)origin.x << 32 | (uint32_t)origin.y;
+    return (size_t)((key * UINT64_C(0x9e3779b97f4a7c15)) >> 32) & (cap - 1);
+}
+
+tile_t *visited_tile(visited_t *visited, vec2i_t origin) {
+    if (2 * (visited->tiles_len + 1) > visited->tiles_cap) {
+        size_t previous_cap = visited->tiles_cap;
+        tile_t *previous_tiles = visited->tiles;
+
+        visited->tiles_cap *= 2;
+        visited->tiles = calloc(visited->tiles_cap, sizeof(tile_t));
+        for (size_t i = 0; i < previous_cap; ++i) {
+            if (not previous_tiles[i].bits) {
+                continue;
+            }
+            size_t h = tile_hash(previous_tiles[i].origin, visited->tiles_cap);
+            while (visited->tiles[h].bits) {
+                h = (h + 1) & (visited->tiles_cap - 1);
+            }
+            visited->tiles[h] = previous_tiles[i];
+        }
+        free(previous_tiles);
+    }
+
+    size_t h = tile_hash(origin, visited->tiles_cap);
+    while (visited->tiles[h].bits and not vec2i_equ(visited->tiles[h].origin, origin)) {
+        h = (h + 1) & (visited->tiles_cap - 1);
+    }
+    if (not visited->tiles[h].bits) {
+        visited->tiles[h].origin = origin;
+        visited->tiles_len++;
+    }
+    return &visited->tiles[h];
+}
+
+void visited_set(visited_t *visited, vec2i_t p) {
+    if (visited->words) {
+        size_t i = (size_t)((long)p.x - visited->min.x) + (size_t)((long)p.y - visited->min.y) * visited->width;
+        visited->words[i / 64] |= UINT64_C(1) << (i % 64);
+        return;
+    }
+
+    vec2i_t origin = {p.x & ~7, p.y & ~7};
+    visited_tile(visited, origin)->bits |= UINT64_C(1) << ((p.y & 7) * 8 + (p.x & 7));
+}
+
+static inline void bits_set_range(uint64_t *words, size_t lo, size_t n) {
+    for (size_t i = lo, end = lo + n; i < end;) {
+        size_t chunk = 64 - i % 64 < end - i ? 64 - i % 64 : end - i;
+        words[i / 64] |= (chunk == 64 ? UINT64_MAX : ((UINT64_C(1) << chunk) - 1)) << (i % 64);
+        i += chunk;
+    }
+}
+
+void visited_set_run(visited_t *visited, vec2i_t from, vec2i_t delta, size_t n) {
+    if (delta.y != 0) {
+        for (size_t i = 1; i < n + 1; ++i) {
+            visited_set(visited, vec2i_add(from, vec2i_mul((int)i, delta)));
+        }
+        return;
+    }
 
-bool vec2i_is_in_array(vec2i_t v, const vec2i_t_array *array) {
-    for (size_t i = 0; i < array->len; ++i) {
-        if (vec2i_equ(v, array->data[i])) {
-            return true;
+    int lo = delta.x > 0 ? from.x + 1 : from.x - (int)n;
+    if (visited->words) {
+        size_t i = (size_t)((long)lo - visited->min.x) + (size_t)((long)from.y - visited->min.y) * visited->width;
+        bits_set_range(visited->words, i, n);
+        return;
+    }
+
+    for (long x = lo, end = (long)lo + (long)n; x < end;) {
+        vec2i_t origin = {(int)x & ~7, from.y & ~7};
+        size_t chunk = 8 - (size_t)(x & 7) < (size_t)(end - x) ? 8 - (size_t)(x & 7) : (size_t)(end - x);
+        bits_set_range(&visited_tile(visited, origin)->bits, (size_t)(from.y & 7) * 8 + (size_t)(x & 7), chunk);
+        x += (long)chunk;
+    }
+}
+
+size_t visited_count(const visited_t *visited) {
+    size_t count = 0;
+    if (visited->words) {
+        size_t width = visited->width, height = (size_t)((long)visited->max.y - visited->min.y + 1);
+        for (size_t i = 0; i < (width * height + 63) / 64; ++i) {
+            count += (size_t)__builtin_popcountll(visited->words[i]);
         }
+        return count;
     }
-    return false;
+
+    for (size_t i = 0; i < visited->tiles_cap; ++i) {
+        count += (size_t)__builtin_popcountll(visited->tiles[i].bits);
+    }
+    return count;
+}
+
+void visited_free(visited_t *visited) {
+    free(visited->words);
+    free(visited->tiles);
 }
 
 int usage(const char *name) {
-    printf("usage: %s input\n", name);
+    printf("usage: %s [-k knots] input\n", name);
+    printf("\t-k: number of knots of an additional rope to simulate alongside the 2 and 10 knots ones\n");
     printf("\tinput: path to input file, '-' to use stdin\n");
     return EXIT_FAILURE;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc - 1 != 1) {
+    if (argc - 1 != 1 and argc - 1 != 3) {
         return usage(argv[0]);
     }
 
-    const char *input = argv[1];
+    size_t n_knots = 0;
+    if (argc - 1 == 3 and (not strequ(argv[1], "-k") or sscanf(argv[2], "%zu", &n_knots) != 1 or n_knots == 0)) {
+        return usage(argv[0]);
+    }
+
+    const char *input = argv[argc - 1];
     FILE *fptr = strequ(input, "-") ? stdin : fopen(input, "r");
     if (not fptr) {
         fprintf(stderr, "could not open %s: %s\n", input, strerror(errno));
@@ -83,6 +208,7 @@ int main(int argc, char *argv[]) {
     size_t len = 0;
 
     move_t_array moves = {0, 0, NULL};
+    vec2i_t head = {0, 0}, min = head, max = head;
     while (getline(&line, &len, fptr) != -1) {
         if (strequ(line, "\n")) {
             continue;
@@ -91,33 +217,77 @@ int main(int argc, char *argv[]) {
         move_t move = {'\0', 0};
         sscanf(line, "%c %zu\n", &move.direction, &move.steps);
 
+        // knots are int vectors, so a move must keep the head within int range for the bulk moves below
+        vec2i_t delta = delta_from_direction(move);
+        int64_t x = (int64_t)head.x + (int64_t)delta.x * (int64_t)(move.steps < INT_MAX ? move.steps : INT_MAX),
+                y = (int64_t)head.y + (int64_t)delta.y * (int64_t)(move.steps < INT_MAX ? move.steps : INT_MAX);
+        if (move.steps > INT_MAX or x < INT_MIN or x > INT_MAX or y < INT_MIN or y > INT_MAX) {
+            fprintf(stderr, "move '%c %zu' takes the head out of range\n", move.direction, move.steps);
+            return EXIT_FAILURE;
+        }
+
         move_t_array_append(&moves, move);
+
+        head = vec2i((int)x, (int)y);
+        min = vec2i(head.x < min.x ? head.x : min.x, head.y < min.y ? head.y : min.y);
+        max = vec2i(head.x > max.x ? head.x : max.x, head.y > max.y ? head.y : max.y);
     }
 
-    {
-        printf("--- Part One ---\n");
-        printf("Simulate your complete hypothetical series of motions. How many positions does the tail of the rope "
-               "visit at least once?\n");
+    const size_t tracked[3] = {2, 10, n_knots};
+    const size_t n_tracked = n_knots != 0 ? 3 : 2;
+
+    size_t n_simulated = n_knots > 10 ? n_knots : 10;
+    vec2i_t *knots = calloc(n_simulated, sizeof(vec2i_t));
 
-        vec2i_t head = {0, 0}, tail = {0, 0};
-        vec2i_t_array tail_positions = {0, 0, NULL};
+    visited_t visited[3];
+    for (size_t i = 0; i < n_tracked; ++i) {
+        visited[i] = visited_new(min, max);
+        visited_set(&visited[i], knots[tracked[i] - 1]);
+    }
 
-        vec2i_t_array_append(&tail_positions, tail);
-        for (size_t i = 0; i < moves.len; ++i) {
-            move_t move = moves.data[i];
-            vec2i_t delta = delta_from_direction(move);
+    for (size_t i = 0; i < moves.len; ++i) {
+        move_t move = moves.data[i];
+        vec2i_t delta = delta_from_direction(move);
 
-            for (size_t j = 0; j < move.steps; ++j) {
-                head = vec2i_add(head, delta);
-                if (not vec2i_is_in_array(tail = follow(head, tail), &tail_positions)) {
-                    vec2i_t_array_append(&tail_positions, tail);
+        for (size_t j = 0; j < move.steps; ++j) {
+            knots[0] = vec2i_add(knots[0], delta);
+
+            size_t moved = 1;
+            bool trailing = true;
+            for (; moved < n_simulated; ++moved) {
+                vec2i_t knot = follow(knots[moved - 1], knots[moved]);
+                if (vec2i_equ(knot, knots[moved])) {
+                    break;
                 }
+                trailing = trailing and vec2i_equ(knot, vec2i_add(knots[moved], delta));
+                knots[moved] = knot;
+            }
+
+            for (size_t k = 0; k < n_tracked; ++k) {
+                if (tracked[k] <= moved) {
+                    visited_set(&visited[k], knots[tracked[k] - 1]);
+                }
+            }
+
+            if (trailing and moved == n_simulated and j + 1 < move.steps) {
+                size_t remaining = move.steps - (j + 1);
+                for (size_t k = 0; k < n_tracked; ++k) {
+                    visited_set_run(&visited[k], knots[tracked[k] - 1], delta, remaining);
+                }
+                for (size_t k = 0; k < n_simulated; ++k) {
+                    knots[k] = vec2i_add(knots[k], vec2i_mul((int)remaining, delta));
+                }
+                break;
             }
         }
+    }
 
-        printf("The tail of the rope visited %zu positions at least once.\n", tail_positions.len);
+    {
+        printf("--- Part One ---\n");
+        printf("Simulate your complete hypothetical series of motions. How many positions does the tail of the rope "
+               "visit at least once?\n");
 
-        vec2i_t_array_free(&tail_positions);
+        printf("The tail of the rope visited %zu positions at least once.\n", visited_count(&visited[0]));
     }
 
     {
@@ -125,35 +295,18 @@ int main(int argc, char *argv[]) {
         printf("Simulate your complete series of motions on a larger rope with ten knots. How many positions does the "
                "tail of the rope visit at least once?\n");
 
-        vec2i_t_array knots = {0, 0, NULL};
-        for (size_t i = 0; i < 10; ++i) {
-            vec2i_t zero = {0, 0};
-            vec2i_t_array_append(&knots, zero);
-        }
-
-        vec2i_t_array tail_positions = {0, 0, NULL};
-        vec2i_t_array_append(&tail_positions, knots.data[9]);
-        for (size_t i = 0; i < moves.len; ++i) {
-            move_t move = moves.data[i];
-            vec2i_t delta = delta_from_direction(move);
-
-            for (size_t j = 0; j < move.steps; ++j) {
-                knots.data[0] = vec2i_add(knots.data[0], delta);
-                for (size_t k = 1; k < 10; ++k) {
-                    knots.data[k] = follow(knots.data[k - 1], knots.data[k]);
-                }
-                if (not vec2i_is_in_array(knots.data[9], &tail_positions)) {
-                    vec2i_t_array_append(&tail_positions, knots.data[9]);
-                }
-            }
-        }
-
-        printf("The tail of the rope visited %zu positions at least once.\n", tail_positions.len);
+        printf("The tail of the rope visited %zu positions at least once.\n", visited_count(&visited[1]));
+    }
 
-        vec2i_t_array_free(&tail_positions);
-        vec2i_t_array_free(&knots);
+    if (n_knots != 0) {
+        printf("The tail of the rope with %zu knots visited %zu positions at least once.\n", n_knots,
+               visited_count(&visited[2]));
     }
 
+    for (size_t i = 0; i < n_tracked; ++i) {
+        visited_free(&visited[i]);
+    }
+    free(knots);
     move_t_array_free(&moves);
 
     free(line);
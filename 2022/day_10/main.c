@@ -6,33 +6,35 @@
 #include "array.h"
 #include "helpers.h"
 
-typedef enum { NOOP = 0, ADDX } op_t;
+ARRAY(int, int_array)
+ARRAY(size_t, size_t_array)
 
 typedef struct {
-    op_t op;
-    int arg;
-    size_t cycles;
-} instruction_t;
+    int_array x;
+    int last;
+} timeline_t;
 
-ARRAY(instruction_t, instruction_array)
-
-typedef struct {
-    size_t cycle;
-    int x;
-} cpu_t;
+static inline int x_during(const timeline_t *timeline, size_t cycle) {
+    return cycle - 1 < timeline->x.len ? timeline->x.data[cycle - 1] : timeline->last;
+}
 
 int usage(const char *name) {
-    printf("usage: %s input\n", name);
+    printf("usage: %s [--cycles file] input\n", name);
+    printf("\t--cycles: path to a file of cycles to probe the signal strength at, absence means 20th, 60th, ...\n");
     printf("\tinput: path to input file, '-' to use stdin\n");
     return EXIT_FAILURE;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc - 1 != 1) {
+    if (argc - 1 != 1 and argc - 1 != 3) {
         return usage(argv[0]);
     }
 
-    const char *input = argv[1];
+    if (argc - 1 == 3 and not strequ(argv[1], "--cycles")) {
+        return usage(argv[0]);
+    }
+
+    const char *input = argv[argc - 1];
     FILE *fptr = strequ(input, "-") ? stdin : fopen(input, "r");
     if (!fptr) {
         fprintf(stderr, "could not open %s: %s\n", input, strerror(errno));
@@ -42,20 +44,38 @@ int main(int argc, char *argv[]) {
     char *line = NULL;
     size_t len = 0;
 
-    instruction_array instructions = {0, 0, NULL};
+    timeline_t timeline = {{0, 0, NULL}, 1};
     while (getline(&line, &len, fptr) != -1) {
         if (strequ(line, "\n")) {
             continue;
         }
 
-        char op[4];
-        int arg = 0;
-        if (sscanf(line, "%s %d\n", op, &arg) != 2) {
-            sscanf(line, "%s\n", op);
+        int_array_append(&timeline.x, timeline.last);
+        if (strnequ(line, "addx", 4)) {
+            int_array_append(&timeline.x, timeline.last);
+            timeline.last += atoi(line + 4);
+        }
+    }
+
+    size_t_array cycles = {0, 0, NULL};
+    if (argc - 1 == 3) {
+        FILE *cycles_fptr = fopen(argv[2], "r");
+        if (!cycles_fptr) {
+            fprintf(stderr, "could not open %s: %s\n", argv[2], strerror(errno));
+            return EXIT_FAILURE;
         }
 
-        instruction_t instruction = {strequ(op, "addx") ? ADDX : NOOP, arg, strequ(op, "addx") ? 2 : 1};
-        instruction_array_append(&instructions, instruction);
+        size_t cycle;
+        while (fscanf(cycles_fptr, "%zu", &cycle) == 1) {
+            if (cycle > 0) {
+                size_t_array_append(&cycles, cycle);
+            }
+        }
+        fclose(cycles_fptr);
+    } else {
+        for (size_t cycle = 20; cycle <= timeline.x.len + 1; cycle += 40) {
+            size_t_array_append(&cycles, cycle);
+        }
     }
 
     {
@@ -63,57 +83,34 @@ int main(int argc, char *argv[]) {
         printf("Find the signal strength during the 20th, 60th, 100th, 140th, 180th, and 220th cycles. What is the sum "
                "of these six signal strengths?\n");
 
-        int signal_strength = 0;
-        cpu_t cpu = {1, 1};
-        for (size_t i = 0; i < instructions.len; ++i) {
-            instruction_t instruction = instructions.data[i];
-            for (size_t j = 0; j < instruction.cycles; ++j) {
-                switch (instruction.op) {
-                case NOOP:
-                    ++cpu.cycle;
-                    break;
-                case ADDX:
-                    ++cpu.cycle;
-                    cpu.x += (j == instruction.cycles - 1) ? instruction.arg : 0;
-                    break;
-                }
-                if (((int)cpu.cycle - 20) % 40 == 0) {
-                    signal_strength += (int)cpu.cycle * cpu.x;
-                }
-            }
+        long signal_strength = 0;
+        for (size_t i = 0; i < cycles.len; ++i) {
+            signal_strength += (long)cycles.data[i] * x_during(&timeline, cycles.data[i]);
         }
 
-        printf("The sum of these six signals strengths is %d.\n", signal_strength);
+        printf("The sum of these six signals strengths is %ld.\n", signal_strength);
     }
 
     {
         printf("--- Part Two ---\n");
         printf("Render the image given by your program. What eight capital letters appear on your CRT?\n");
 
-        cpu_t cpu = {1, 1};
-        for (size_t i = 0; i < instructions.len; ++i) {
-            instruction_t instruction = instructions.data[i];
-            for (size_t j = 0; j < instruction.cycles; ++j) {
-                int x = (int)(cpu.cycle - 1) % 40;
-                if (x == 0 and i != 0) {
-                    printf("\n");
-                }
-                printf("%c", abs(x - cpu.x) > 1 ? '.' : '#');
-                switch (instruction.op) {
-                case NOOP:
-                    ++cpu.cycle;
-                    break;
-                case ADDX:
-                    ++cpu.cycle;
-                    cpu.x += (j == instruction.cycles - 1) ? instruction.arg : 0;
-                    break;
-                }
+        char *framebuffer = calloc(timeline.x.len + timeline.x.len / 40 + 1, sizeof(char));
+        char *pixel = framebuffer;
+        for (size_t cycle = 1; cycle < timeline.x.len + 1; ++cycle) {
+            int x = (int)(cycle - 1) % 40;
+            *pixel++ = abs(x - x_during(&timeline, cycle)) > 1 ? '.' : '#';
+            if (x == 39 or cycle == timeline.x.len) {
+                *pixel++ = '\n';
             }
         }
-        printf("\n");
+        fwrite(framebuffer, sizeof(char), (size_t)(pixel - framebuffer), stdout);
+
+        free(framebuffer);
     }
 
-    instruction_array_free(&instructions);
+    size_t_array_free(&cycles);
+    int_array_free(&timeline.x);
 
     free(line);
     if (fptr != stdin) {
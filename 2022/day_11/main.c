@@ -1,54 +1,253 @@
 #include <errno.h>
+#include <inttypes.h>
 #include <iso646.h>
-#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "array.h"
-#include "dequeue.h"
 #include "helpers.h"
 
+__extension__ typedef unsigned __int128 u128;
+
 ARRAY(size_t, size_t_array)
-DEQUEUE(size_t, size_t_queue)
+ARRAY(uint64_t, u64_array)
+ARRAY(u128, u128_array)
+
+static inline u128 fastmod_m(uint64_t d) { return ~(u128)0 / d + 1; }
+
+static inline uint64_t fastmod(uint64_t a, u128 m, uint64_t d) {
+    u128 lowbits = m * a;
+    u128 high = (((lowbits & UINT64_MAX) * d) >> 64) + (lowbits >> 64) * d;
+    return (uint64_t)(high >> 64);
+}
+
+// fastmod_m(1) wraps around to 0, and m - 1 then makes every value divisible by 1
+static inline bool is_divisible(uint64_t a, u128 m) { return m * a <= m - 1; }
+
+static inline uint64_t gcd(uint64_t a, uint64_t b) {
+    while (b != 0) {
+        uint64_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
 
-typedef size_t (*operation_f)(size_t, size_t);
+// new = old * (square ? old : mul) + add, square being a mask of all ones or zeros
 typedef struct {
-    size_t x;
-    operation_f f;
-} operation_t;
-size_t operation_call(const operation_t *operation, size_t worry) { return operation->f(operation->x, worry); }
-
-size_t add(size_t value, size_t worry) { return worry + value; }
-size_t mul(size_t value, size_t worry) { return worry * value; }
-size_t squ(size_t value, size_t worry) {
-    (void)value;
-    return worry * worry;
+    size_t len;
+    u64_array mul, add, square;
+    u64_array divisor;
+    u128_array divisor_m;
+    size_t_array siblings[2];
+} monkey_table_t;
+
+static inline uint64_t operation(const monkey_table_t *monkeys, size_t monkey, uint64_t old) {
+    uint64_t square = monkeys->square.data[monkey];
+    return old * ((old & square) | (monkeys->mul.data[monkey] & ~square)) + monkeys->add.data[monkey];
+}
+
+static inline size_t target(const monkey_table_t *monkeys, size_t monkey, uint64_t worry) {
+    return monkeys->siblings[not is_divisible(worry, monkeys->divisor_m.data[monkey])].data[monkey];
+}
+
+void monkey_table_free(monkey_table_t *monkeys) {
+    u64_array_free(&monkeys->mul);
+    u64_array_free(&monkeys->add);
+    u64_array_free(&monkeys->square);
+    u64_array_free(&monkeys->divisor);
+    u128_array_free(&monkeys->divisor_m);
+    size_t_array_free(&monkeys->siblings[0]);
+    size_t_array_free(&monkeys->siblings[1]);
+}
+
+typedef struct {
+    size_t len;
+    u64_array worry;
+    size_t_array owner;
+} item_pool_t;
+
+void item_pool_free(item_pool_t *items) {
+    u64_array_free(&items->worry);
+    size_t_array_free(&items->owner);
+}
+
+typedef struct {
+    uint64_t value;
+    u128 m;
+} modulus_t;
+
+void round_step(const monkey_table_t *monkeys, modulus_t common_multiple, size_t *monkey, uint64_t *worry,
+                size_t_array *inspected) {
+    size_t from;
+    do {
+        from = *monkey;
+        *worry = fastmod(operation(monkeys, from, *worry), common_multiple.m, common_multiple.value);
+        *monkey = target(monkeys, from, *worry);
+        size_t_array_append(inspected, from);
+    } while (*monkey > from);
+}
+
+typedef struct {
+    size_t key, round, stamp;
+} seen_t;
+
+typedef struct {
+    size_t cap, len, stamp;
+    seen_t *data;
+} seen_map;
+
+static inline size_t seen_hash(size_t key, size_t cap) {
+    return (size_t)((key * 0x9e3779b97f4a7c15) >> 17) & (cap - 1);
+}
+
+seen_t *seen_map_find(seen_map *map, size_t key) {
+    size_t h = seen_hash(key, map->cap);
+    while (map->data[h].stamp == map->stamp and map->data[h].key != key) {
+        h = (h + 1) & (map->cap - 1);
+    }
+    return &map->data[h];
 }
 
-typedef struct monkey_t monkey_t;
-struct monkey_t {
-    size_t_queue items;
-    operation_t operation;
-    size_t divisor;
-    size_t siblings[2];
-};
+void seen_map_insert(seen_map *map, size_t key, size_t round) {
+    if (2 * (map->len + 1) > map->cap) {
+        size_t previous_cap = map->cap;
+        seen_t *previous_data = map->data;
 
-ARRAY(monkey_t, monkey_array)
+        map->cap = map->cap ? map->cap * 2 : 1024;
+        map->data = calloc(map->cap, sizeof(seen_t));
+        for (size_t i = 0; i < previous_cap; ++i) {
+            if (previous_data[i].stamp == map->stamp) {
+                *seen_map_find(map, previous_data[i].key) = previous_data[i];
+            }
+        }
+        free(previous_data);
+    }
+
+    seen_t entry = {key, round, map->stamp};
+    *seen_map_find(map, key) = entry;
+    map->len++;
+}
+
+void count_rounds(size_t *inspections, const size_t_array *inspected, const size_t_array *offsets, size_t begin,
+                  size_t end, size_t times) {
+    for (size_t i = offsets->data[begin]; i < offsets->data[end]; ++i) {
+        inspections[inspected->data[i]] += times;
+    }
+}
+
+void simulate_item(const monkey_table_t *monkeys, modulus_t common_multiple, size_t n_rounds, size_t monkey,
+                   uint64_t worry, size_t *inspections, seen_map *seen, size_t_array *inspected,
+                   size_t_array *offsets) {
+    seen->stamp++;
+    seen->len = 0;
+    inspected->len = 0;
+    offsets->len = 0;
+
+    size_t round = 0;
+    seen_t *first = NULL;
+    for (; round < n_rounds; ++round) {
+        size_t key = worry * monkeys->len + monkey;
+        if (seen->cap > 0 and (first = seen_map_find(seen, key))->stamp == seen->stamp) {
+            break;
+        }
+        first = NULL;
+        seen_map_insert(seen, key, round);
+        size_t_array_append(offsets, inspected->len);
+        round_step(monkeys, common_multiple, &monkey, &worry, inspected);
+    }
+    size_t_array_append(offsets, inspected->len);
+
+    if (not first) {
+        count_rounds(inspections, inspected, offsets, 0, round, 1);
+        return;
+    }
+
+    size_t start = first->round, period = round - start, remaining = n_rounds - start;
+    count_rounds(inspections, inspected, offsets, 0, start, 1);
+    count_rounds(inspections, inspected, offsets, start, round, remaining / period);
+    count_rounds(inspections, inspected, offsets, start, start + remaining % period, 1);
+}
+
+typedef struct {
+    const monkey_table_t *monkeys;
+    modulus_t common_multiple;
+    size_t n_rounds;
+    const item_pool_t *items;
+    size_t *next;
+    size_t *inspections;
+} worker_t;
+
+void *simulate_items(void *arg) {
+    worker_t *worker = arg;
+
+    seen_map seen = {0, 0, 0, NULL};
+    size_t_array inspected = {0, 0, NULL}, offsets = {0, 0, NULL};
+
+    size_t i;
+    while ((i = __atomic_fetch_add(worker->next, 1, __ATOMIC_RELAXED)) < worker->items->len) {
+        uint64_t worry = fastmod(worker->items->worry.data[i], worker->common_multiple.m,
+                                 worker->common_multiple.value);
+        simulate_item(worker->monkeys, worker->common_multiple, worker->n_rounds, worker->items->owner.data[i], worry,
+                      worker->inspections, &seen, &inspected, &offsets);
+    }
+
+    size_t_array_free(&offsets);
+    size_t_array_free(&inspected);
+    free(seen.data);
+
+    return NULL;
+}
+
+u128 monkey_business(const size_t *inspections, size_t n) {
+    size_t most_active[2] = {0};
+    for (size_t i = 0; i < n; ++i) {
+        if (inspections[i] > most_active[0]) {
+            most_active[1] = most_active[0];
+            most_active[0] = inspections[i];
+            continue;
+        }
+        if (inspections[i] > most_active[1]) {
+            most_active[1] = inspections[i];
+            continue;
+        }
+    }
+    return (u128)most_active[0] * most_active[1];
+}
+
+void print_u128(u128 n) {
+    char digits[40];
+    size_t i = sizeof(digits);
+    digits[--i] = '\0';
+    do {
+        digits[--i] = (char)('0' + (int)(n % 10));
+        n /= 10;
+    } while (n > 0);
+    printf("%s", digits + i);
+}
 
 int usage(const char *name) {
-    printf("usage: %s input\n", name);
-    printf("\tinput: path to input file\n");
-    printf("reading file from stdin is not supported.\n");
+    printf("usage: %s [--rounds n] input\n", name);
+    printf("\t--rounds: number of rounds of part two, absence means 10000\n");
+    printf("\tinput: path to input file, '-' to use stdin\n");
     return EXIT_FAILURE;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc - 1 != 1) {
+    if (argc - 1 != 1 and argc - 1 != 3) {
+        return usage(argv[0]);
+    }
+
+    size_t n_rounds = 10000;
+    if (argc - 1 == 3 and (not strequ(argv[1], "--rounds") or sscanf(argv[2], "%zu", &n_rounds) != 1)) {
         return usage(argv[0]);
     }
 
-    const char *input = argv[1];
-    FILE *fptr = fopen(input, "r");
+    const char *input = argv[argc - 1];
+    FILE *fptr = strequ(input, "-") ? stdin : fopen(input, "r");
     if (!fptr) {
         fprintf(stderr, "could not open %s: %s\n", input, strerror(errno));
         return EXIT_FAILURE;
@@ -57,208 +256,156 @@ int main(int argc, char *argv[]) {
     char *line = NULL;
     size_t len = 0;
 
-    {
-        monkey_array monkeys = {0, 0, NULL};
-        while (getline(&line, &len, fptr) != -1) {
-            if (strequ(line, "\n")) {
-                continue;
-            }
-
-            size_t index;
-            if (not(sscanf(line, "Monkey %zu:\n", &index) == 1)) {
-                continue;
+    monkey_table_t monkeys = {0};
+    item_pool_t items = {0};
+    while (getline(&line, &len, fptr) != -1) {
+        size_t index;
+        uint64_t value;
+        if (sscanf(line, "Monkey %zu:\n", &index) == 1) {
+            monkeys.len++;
+        } else if (strnequ(line, "  Starting items:", 17)) {
+            char *end = line + 17;
+            for (char *s = end; (value = strtoull(s, &end, 10)), end != s; s = end + (*end == ',')) {
+                u64_array_append(&items.worry, value);
+                size_t_array_append(&items.owner, monkeys.len - 1);
+                items.len++;
             }
-
-            getline(&line, &len, fptr);
-            size_t line_length = strlen(line), control = 0;
-            fseek(fptr, -(long)strlen(line), SEEK_CUR);
-
-            size_t_queue items = {0, 0, NULL, NULL};
-            getdelim(&line, &len, ':', fptr);
-            control += strlen(line);
-            while (control < line_length) {
-                getdelim(&line, &len, ',', fptr);
-                control += strlen(line);
-
-                size_t item;
-                sscanf(line, " %zu", &item);
-                size_t_queue_push_back(&items, item);
-            }
-            fseek(fptr, (long)line_length - (long)control, SEEK_CUR);
-
-            getline(&line, &len, fptr);
-            operation_t operation = {0, NULL};
-            if (strequ(line, "  Operation: new = old * old\n")) {
-                operation.f = squ;
-            } else if (sscanf(line, "  Operation: new = old + %zu\n", &operation.x) == 1) {
-                operation.f = add;
-            } else if (sscanf(line, "  Operation: new = old * %zu\n", &operation.x) == 1) {
-                operation.f = mul;
+        } else if (strequ(line, "  Operation: new = old * old\n")) {
+            u64_array_append(&monkeys.mul, 0);
+            u64_array_append(&monkeys.add, 0);
+            u64_array_append(&monkeys.square, UINT64_MAX);
+        } else if (sscanf(line, "  Operation: new = old + %" SCNu64 "\n", &value) == 1) {
+            u64_array_append(&monkeys.mul, 1);
+            u64_array_append(&monkeys.add, value);
+            u64_array_append(&monkeys.square, 0);
+        } else if (sscanf(line, "  Operation: new = old * %" SCNu64 "\n", &value) == 1) {
+            u64_array_append(&monkeys.mul, value);
+            u64_array_append(&monkeys.add, 0);
+            u64_array_append(&monkeys.square, 0);
+        } else if (sscanf(line, "  Test: divisible by %" SCNu64 "\n", &value) == 1) {
+            if (value == 0) {
+                fprintf(stderr, "monkey %zu tests divisibility by 0\n", monkeys.len - 1);
+                return EXIT_FAILURE;
             }
-
-            monkey_t monkey = {items, operation, 1, {0}};
-            getline(&line, &len, fptr);
-            sscanf(line, "  Test: divisible by %zu\n", &monkey.divisor);
-
-            getline(&line, &len, fptr);
-            sscanf(line, "    If true: throw to monkey %zu\n", &monkey.siblings[0]);
-            getline(&line, &len, fptr);
-            sscanf(line, "    If false: throw to monkey %zu\n", &monkey.siblings[1]);
-
-            monkey_array_append(&monkeys, monkey);
+            u64_array_append(&monkeys.divisor, value);
+            u128_array_append(&monkeys.divisor_m, fastmod_m(value));
+        } else if (sscanf(line, "    If true: throw to monkey %zu\n", &index) == 1) {
+            size_t_array_append(&monkeys.siblings[0], index);
+        } else if (sscanf(line, "    If false: throw to monkey %zu\n", &index) == 1) {
+            size_t_array_append(&monkeys.siblings[1], index);
         }
+    }
+
+    size_t *inspections = calloc(monkeys.len, sizeof(size_t));
 
+    {
         printf("--- Part One ---\n");
         printf("Figure out which monkeys to chase by counting how many items they inspect over 20 rounds. What is the "
                "level of monkey business after 20 rounds of stuff-slinging simian shenanigans?\n");
 
-        size_t_array inspections = {0, 0, NULL};
+        const size_t none = SIZE_MAX;
+        uint64_t *worries = calloc(items.len, sizeof(uint64_t));
+        size_t *next = calloc(items.len, sizeof(size_t));
+        size_t *heads = calloc(monkeys.len, sizeof(size_t)), *tails = calloc(monkeys.len, sizeof(size_t));
         for (size_t i = 0; i < monkeys.len; ++i) {
-            size_t_array_append(&inspections, 0);
+            heads[i] = tails[i] = none;
+        }
+        for (size_t i = 0; i < items.len; ++i) {
+            size_t owner = items.owner.data[i];
+            worries[i] = items.worry.data[i];
+            next[i] = none;
+            *(tails[owner] != none ? &next[tails[owner]] : &heads[owner]) = i;
+            tails[owner] = i;
         }
 
         for (size_t i = 0; i < 20; ++i) {
             for (size_t j = 0; j < monkeys.len; ++j) {
-                while (monkeys.data[j].items.len > 0) {
-                    size_t worry =
-                        operation_call(&monkeys.data[j].operation, size_t_queue_pop_front(&monkeys.data[j].items)) / 3;
-                    size_t index = worry % monkeys.data[j].divisor == 0 ? 0 : 1;
-                    size_t_queue_push_back(&monkeys.data[monkeys.data[j].siblings[index]].items, worry);
-                    inspections.data[j]++;
+                size_t item = heads[j];
+                heads[j] = tails[j] = none;
+                while (item != none) {
+                    size_t following = next[item];
+                    worries[item] = operation(&monkeys, j, worries[item]) / 3;
+
+                    size_t to = target(&monkeys, j, worries[item]);
+                    next[item] = none;
+                    *(tails[to] != none ? &next[tails[to]] : &heads[to]) = item;
+                    tails[to] = item;
+
+                    inspections[j]++;
+                    item = following;
                 }
             }
         }
 
-        size_t most_active[2] = {0};
-        for (size_t i = 0; i < inspections.len; ++i) {
-            if (inspections.data[i] > most_active[0]) {
-                most_active[1] = most_active[0];
-                most_active[0] = inspections.data[i];
-                continue;
-            }
-            if (inspections.data[i] > most_active[1]) {
-                most_active[1] = inspections.data[i];
-                continue;
-            }
-        }
+        printf("The level of monkey business after 20 rounds of stuff-slinging simian shenanigans is ");
+        print_u128(monkey_business(inspections, monkeys.len));
+        printf(".\n");
 
-        printf("The level of monkey business after 20 rounds of stuff-slinging simian shenanigans is %lu.\n",
-               most_active[0] * most_active[1]);
-
-        size_t_array_free(&inspections);
-
-        for (size_t i = 0; i < monkeys.len; ++i) {
-            size_t_queue_free(&monkeys.data[i].items);
-        }
-        monkey_array_free(&monkeys);
+        free(tails);
+        free(heads);
+        free(next);
+        free(worries);
     }
 
-    rewind(fptr);
-
     {
-        monkey_array monkeys = {0, 0, NULL};
-        while (getline(&line, &len, fptr) != -1) {
-            if (strequ(line, "\n")) {
-                continue;
-            }
-
-            size_t index;
-            if (not(sscanf(line, "Monkey %zu:\n", &index) == 1)) {
-                continue;
-            }
-
-            getline(&line, &len, fptr);
-            size_t line_length = strlen(line), control = 0;
-            fseek(fptr, -(long)strlen(line), SEEK_CUR);
-
-            size_t_queue items = {0, 0, NULL, NULL};
-            getdelim(&line, &len, ':', fptr);
-            control += strlen(line);
-            while (control < line_length) {
-                getdelim(&line, &len, ',', fptr);
-                control += strlen(line);
-
-                size_t item;
-                sscanf(line, " %zu", &item);
-                size_t_queue_push_back(&items, item);
-            }
-            fseek(fptr, (long)line_length - (long)control, SEEK_CUR);
-
-            getline(&line, &len, fptr);
-            operation_t operation = {0, NULL};
-            if (strequ(line, "  Operation: new = old * old\n")) {
-                operation.f = squ;
-            } else if (sscanf(line, "  Operation: new = old + %zu\n", &operation.x) == 1) {
-                operation.f = add;
-            } else if (sscanf(line, "  Operation: new = old * %zu\n", &operation.x) == 1) {
-                operation.f = mul;
-            }
-
-            monkey_t monkey = {items, operation, 1, {0}};
-            getline(&line, &len, fptr);
-            sscanf(line, "  Test: divisible by %zu\n", &monkey.divisor);
-
-            getline(&line, &len, fptr);
-            sscanf(line, "    If true: throw to monkey %zu\n", &monkey.siblings[0]);
-            getline(&line, &len, fptr);
-            sscanf(line, "    If false: throw to monkey %zu\n", &monkey.siblings[1]);
-
-            monkey_array_append(&monkeys, monkey);
-        }
-
         printf("--- Part Two ---\n");
         printf("Worry levels are no longer divided by three after each item is inspected; you'll need to find another "
                "way to keep your worry levels manageable. Starting again from the initial state in your puzzle input, "
-               "what is the level of monkey business after 10000 rounds?\n");
+               "what is the level of monkey business after %zu rounds?\n",
+               n_rounds);
+
+        memset(inspections, 0, monkeys.len * sizeof(size_t));
 
-        size_t_array inspections = {0, 0, NULL};
+        // worry levels are kept below the least common multiple of the divisors, which must stay under 2^32 for
+        // squaring a worry level to fit in 64 bits
+        modulus_t common_multiple = {1, 0};
         for (size_t i = 0; i < monkeys.len; ++i) {
-            size_t_array_append(&inspections, 0);
+            uint64_t divisor = monkeys.divisor.data[i];
+            if (__builtin_mul_overflow(common_multiple.value, divisor / gcd(common_multiple.value, divisor),
+                                       &common_multiple.value) or
+                common_multiple.value > UINT32_MAX) {
+                fprintf(stderr, "the least common multiple of the divisors does not fit in 32 bits\n");
+                return EXIT_FAILURE;
+            }
         }
+        common_multiple.m = fastmod_m(common_multiple.value);
 
-        size_t common_multiple = 1;
+        // the operands are reduced too, so old * mul + add stays below the square of the common multiple
         for (size_t i = 0; i < monkeys.len; ++i) {
-            common_multiple *= monkeys.data[i].divisor;
+            monkeys.mul.data[i] = fastmod(monkeys.mul.data[i], common_multiple.m, common_multiple.value);
+            monkeys.add.data[i] = fastmod(monkeys.add.data[i], common_multiple.m, common_multiple.value);
         }
 
-        const size_t n_rounds = 10000;
-        for (size_t i = 0; i < n_rounds; ++i) {
-            for (size_t j = 0; j < monkeys.len; ++j) {
-                while (monkeys.data[j].items.len > 0) {
-                    size_t worry =
-                        operation_call(&monkeys.data[j].operation, size_t_queue_pop_front(&monkeys.data[j].items)) %
-                        common_multiple;
-                    size_t index = worry % monkeys.data[j].divisor == 0 ? 0 : 1;
-                    size_t_queue_push_back(&monkeys.data[monkeys.data[j].siblings[index]].items, worry);
-                    inspections.data[j]++;
-                }
-            }
-        }
+        long n_processors = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t n_threads = n_processors > 0 ? (size_t)n_processors : 1;
 
-        size_t most_active[2] = {0};
-        for (size_t i = 0; i < inspections.len; ++i) {
-            if (inspections.data[i] > most_active[0]) {
-                most_active[1] = most_active[0];
-                most_active[0] = inspections.data[i];
-                continue;
-            }
-            if (inspections.data[i] > most_active[1]) {
-                most_active[1] = inspections.data[i];
-                continue;
+        size_t next = 0;
+        pthread_t *threads = calloc(n_threads, sizeof(pthread_t));
+        worker_t *workers = calloc(n_threads, sizeof(worker_t));
+        for (size_t i = 0; i < n_threads; ++i) {
+            worker_t worker = {&monkeys, common_multiple, n_rounds, &items, &next, calloc(monkeys.len, sizeof(size_t))};
+            workers[i] = worker;
+            pthread_create(&threads[i], NULL, simulate_items, &workers[i]);
+        }
+        for (size_t i = 0; i < n_threads; ++i) {
+            pthread_join(threads[i], NULL);
+            for (size_t j = 0; j < monkeys.len; ++j) {
+                inspections[j] += workers[i].inspections[j];
             }
+            free(workers[i].inspections);
         }
-        printf("\n");
-
-        printf("The level of monkey business after 10000 rounds is %lu.\n", most_active[0] * most_active[1]);
-
-        size_t_array_free(&inspections);
+        free(workers);
+        free(threads);
 
-        for (size_t i = 0; i < monkeys.len; ++i) {
-            size_t_queue_free(&monkeys.data[i].items);
-        }
-        monkey_array_free(&monkeys);
+        printf("The level of monkey business after %zu rounds is ", n_rounds);
+        print_u128(monkey_business(inspections, monkeys.len));
+        printf(".\n");
     }
 
+    free(inspections);
+    item_pool_free(&items);
+    monkey_table_free(&monkeys);
+
     free(line);
     if (fptr != stdin) {
         fclose(fptr);
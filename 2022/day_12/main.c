@@ -1,199 +1,179 @@
 #include <errno.h>
 #include <iso646.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-#include "array.h"
+#include "grid_search.h"
 #include "helpers.h"
-#include "vec2i.h"
-
-ARRAY(int, int_array)
-ARRAY(vec2i_t, vec2i_array)
+#include "mapped.h"
 
+// heights surrounded by a border of visited cells, so neighbors need no bounds check, stride is width + 2
 typedef struct {
-    size_t width, height;
-    int_array heights;
+    size_t width, height, stride;
+    size_t start, end;
+    uint8_t *heights;
 } heightmap_t;
 
-int height_at(const heightmap_t *heightmap, vec2i_t p) {
-    return heightmap->heights.data[(size_t)p.x + (size_t)p.y * heightmap->width];
-}
-
-bool is_traversable(const heightmap_t *heightmap, vec2i_t from, vec2i_t to) {
-    if (not(to.x >= 0 and to.x < (int)heightmap->width and to.y >= 0 and to.y < (int)heightmap->height)) {
-        return false;
-    }
-
-    return height_at(heightmap, from) + 1 >= height_at(heightmap, to);
-}
-
-typedef struct node_t node_t;
-struct node_t {
-    vec2i_t p;
-    int g, h;
-    node_t *parent;
-};
-
-static inline int f_cost(node_t *node) { return node->g * node->h; }
+#define VISITED 0x80
 
-ARRAY(node_t *, node_array)
-
-static inline void add_node(node_array *nodes, node_t *node) { node_array_append(nodes, node); }
-
-void remove_node(node_array *nodes, const node_t *node) {
-    for (size_t i = 0; i < nodes->len; ++i) {
-        if (nodes->data[i] == node) {
-            memmove(nodes->data + i, nodes->data + i + 1, (nodes->len - 1 - i) * sizeof(node_t *));
-            nodes->len--;
-        }
-    }
-}
-
-node_t *get_node(const node_array *nodes, vec2i_t p) {
-    for (size_t i = 0; i < nodes->len; ++i) {
-        if (vec2i_equ(nodes->data[i]->p, p)) {
-            return nodes->data[i];
-        }
-    }
-    return NULL;
-}
+// kept apart from grid_search.h, whose generic BFS pays for its visited bitset and general neighbor list on every edge,
+// it only answers again under --check
+// walks steps backwards from E level by level, flagging visited cells in their height byte, and stops as soon as S
+// and an elevation a cell have both been reached
+bool reverse_bfs(heightmap_t *heightmap, long *start_count, long *lowest_count) {
+    uint8_t *heights = heightmap->heights;
+    const size_t stride = heightmap->stride;
 
-static inline bool is_in(const node_array *nodes, vec2i_t p) {
-    for (size_t i = 0; i < nodes->len; ++i) {
-        if (vec2i_equ(nodes->data[i]->p, p)) {
-            return true;
-        }
+    uint32_t *queue = malloc(heightmap->width * heightmap->height * sizeof(uint32_t));
+    if (not queue) {
+        return false;
     }
-    return false;
-}
 
-node_t *lowest_cost(const node_array *nodes) {
-    int min = -1;
-    size_t index = 0;
-    for (size_t i = 0; i < nodes->len; ++i) {
-        if (f_cost(nodes->data[i]) < min) {
-            min = f_cost(nodes->data[i]);
-            index = i;
-        }
+    // without an E the end is left on cell 0, in the border
+    *start_count = *lowest_count = -1;
+    size_t head = 0, tail = 0;
+    if (heightmap->end == 0) {
+        free(queue);
+        return true;
     }
-    return nodes->data[index];
-}
-
-static inline int distance(vec2i_t a, vec2i_t b) { return abs(a.x - b.x) + abs(a.y - b.y); }
-
-int a_star(const heightmap_t *heightmap, vec2i_t start_p, vec2i_t end_p) {
-    node_t *start = malloc(sizeof(node_t));
-    start->p = start_p;
-    start->g = 0;
-    start->h = 0;
-    start->parent = NULL;
-
-    node_array open = {0, 0, NULL}, closed = {0, 0, NULL};
-    add_node(&closed, start);
-
-    node_t *current = start;
-    while (not vec2i_equ(current->p, end_p)) {
-        vec2i_t neighbors[4] = {vec2i_add(current->p, vec2i(0, +1)), vec2i_add(current->p, vec2i(+1, 0)),
-                                vec2i_add(current->p, vec2i(0, -1)), vec2i_add(current->p, vec2i(-1, 0))};
-        for (size_t i = 0; i < 4; ++i) {
-            if (not is_traversable(heightmap, current->p, neighbors[i]) or is_in(&closed, neighbors[i])) {
-                continue;
+    heights[heightmap->end] |= VISITED;
+    queue[tail++] = (uint32_t)heightmap->end;
+    for (long level = 0; head < tail; ++level) {
+        for (size_t level_end = tail; head < level_end; ++head) {
+            size_t u = queue[head];
+            uint8_t lowest = heights[u] & (VISITED - 1);
+            if (u == heightmap->start) {
+                *start_count = level;
             }
-
-            node_t *neighbor = get_node(&open, neighbors[i]);
-            if (not neighbor) {
-                neighbor = malloc(sizeof(node_t));
-                neighbor->p = neighbors[i];
-                neighbor->g = distance(neighbor->p, current->p);
-                neighbor->h = distance(neighbor->p, end_p);
-                neighbor->parent = current;
-            } else if (current->g + 1 < neighbor->g) {
-                neighbor->g = current->g + 1;
-                neighbor->parent = current;
+            if (lowest == 0 and *lowest_count < 0) {
+                *lowest_count = level;
             }
 
-            if (not is_in(&open, neighbor->p)) {
-                add_node(&open, neighbor);
+            const size_t neighbors[4] = {u - stride, u + 1, u + stride, u - 1};
+            for (size_t i = 0; i < 4; ++i) {
+                uint8_t height = heights[neighbors[i]];
+                if (height & VISITED or height + 1 < lowest) {
+                    continue;
+                }
+                heights[neighbors[i]] = height | VISITED;
+                queue[tail++] = (uint32_t)neighbors[i];
             }
         }
-
-        if (open.len == 0) {
+        if (*start_count >= 0 and *lowest_count >= 0) {
             break;
         }
-        current = lowest_cost(&open);
-        remove_node(&open, current);
-        add_node(&closed, current);
-    }
-
-    int count = 0;
-    if (open.len == 0) {
-        count = -1;
-    } else {
-        while (current != start) {
-            current = current->parent;
-            count++;
-        }
     }
 
-    for (size_t i = 0; i < closed.len; ++i) {
-        free(closed.data[closed.len - 1 - i]);
+    free(queue);
+    return true;
+}
+
+// steps backwards from a cell, border bytes being never allowed
+#define REVERSE_STEP(grid, from, to, user)                                                                             \
+    ((grid)->cells[to] < VISITED and (grid)->cells[to] + 1 >= (grid)->cells[from])
+
+GRID_BFS(reverse_grid_bfs, REVERSE_STEP)
+
+// both answers from the generic breadth first search of grid_search.h over the padded heightmap, which must not have
+// been searched yet
+bool reverse_grid_counts(const heightmap_t *heightmap, long *start_count, long *lowest_count) {
+    grid_t grid = {heightmap->stride, heightmap->height + 2, heightmap->heights};
+    grid_workspace_t ws = {0};
+    if (not grid_workspace_reserve(&ws, grid.width * grid.height, GRID_QUEUE)) {
+        return false;
     }
-    node_array_free(&closed);
 
-    for (size_t i = 0; i < open.len; ++i) {
-        free(open.data[open.len - 1 - i]);
+    *start_count = *lowest_count = -1;
+    if (heightmap->end != 0) {
+        uint32_t source = (uint32_t)heightmap->end;
+        reverse_grid_bfs(&grid, &ws, &source, 1, GRID_NONE, NULL);
+        for (size_t i = 0; i < grid.width * grid.height; ++i) {
+            if (grid.cells[i] == 0 and ws.dist[i] != GRID_NONE and (*lowest_count < 0 or ws.dist[i] < *lowest_count)) {
+                *lowest_count = ws.dist[i];
+            }
+        }
+        *start_count = ws.dist[heightmap->start] != GRID_NONE ? (long)ws.dist[heightmap->start] : -1;
     }
-    node_array_free(&open);
 
-    return count;
+    grid_workspace_free(&ws);
+    return true;
 }
 
 int usage(const char *name) {
-    printf("usage: %s input\n", name);
+    printf("usage: %s [--check] input\n", name);
+    printf("\t--check: answers again with the generic search of grid_search.h and fails when the answers differ\n");
     printf("\tinput: path to input file, '-' to use stdin\n");
     return EXIT_FAILURE;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc - 1 != 1) {
+    if (argc - 1 != 1 and (argc - 1 != 2 or not strequ(argv[1], "--check"))) {
         return usage(argv[0]);
     }
 
-    const char *input = argv[1];
+    const bool check = argc - 1 == 2;
+    const char *input = argv[argc - 1];
     FILE *fptr = strequ(input, "-") ? stdin : fopen(input, "r");
     if (!fptr) {
         fprintf(stderr, "could not open %s: %s\n", input, strerror(errno));
         return EXIT_FAILURE;
     }
 
-    char *line = NULL;
-    size_t len = 0;
-
-    vec2i_t start_p = {0, 0}, end_p = {0, 0};
-    heightmap_t heightmap = {0, 0, {0, 0, NULL}};
-    while (getline(&line, &len, fptr) != -1) {
-        if (strequ(line, "\n")) {
-            continue;
-        }
+    mapped_t mapped = mapped_open(fptr);
+    if (not mapped.data) {
+        fprintf(stderr, "could not read %s: %s\n", input, strerror(errno));
+        return EXIT_FAILURE;
+    }
 
-        heightmap.height++;
-        if (heightmap.width == 0) {
-            heightmap.width = strlen(line) - 1;
-        }
-        for (char *c = line; *c != '\n'; ++c) {
-            if (not(*c >= 'a' or *c <= 'z' or *c == 'S' or *c == 'E')) {
-                continue;
-            }
-            int_array_append(&heightmap.heights, *c == 'S' ? 'a' - 'a' : *c == 'E' ? 'z' - 'a' : *c - 'a');
-            if (*c == 'S') {
-                start_p = vec2i((int)(heightmap.heights.len - 1) % (int)heightmap.width,
-                                (int)(heightmap.heights.len - 1) / (int)heightmap.width);
+    heightmap_t heightmap = {0, 0, 0, 0, 0, NULL};
+    const char *newline = memchr(mapped.data, '\n', mapped.len);
+    heightmap.width = newline ? (size_t)(newline - mapped.data) : mapped.len;
+    heightmap.stride = heightmap.width + 2;
+    const size_t line = heightmap.width + 1, max_height = mapped.len / line;
+    if ((max_height + 2) * heightmap.stride >= UINT32_MAX) {
+        fprintf(stderr, "heightmap of %zux%zu is too large\n", heightmap.width, max_height);
+        return EXIT_FAILURE;
+    }
+    heightmap.heights = malloc((max_height + 2) * heightmap.stride);
+    if (not heightmap.heights) {
+        fprintf(stderr, "could not allocate a %zux%zu heightmap\n", heightmap.width, max_height);
+        return EXIT_FAILURE;
+    }
+    memset(heightmap.heights, VISITED, (max_height + 2) * heightmap.stride);
+
+    while (heightmap.width > 0 and heightmap.height * line + heightmap.width <= mapped.len and
+           mapped.data[heightmap.height * line] != '\n') {
+        const char *row = mapped.data + heightmap.height * line;
+        for (size_t x = 0, i = (heightmap.height + 1) * heightmap.stride + 1; x < heightmap.width; ++x, ++i) {
+            if (row[x] == 'S') {
+                heightmap.start = i;
             }
-            if (*c == 'E') {
-                end_p = vec2i((int)(heightmap.heights.len - 1) % (int)heightmap.width,
-                              (int)(heightmap.heights.len - 1) / (int)heightmap.width);
+            if (row[x] == 'E') {
+                heightmap.end = i;
             }
+            heightmap.heights[i] = (uint8_t)((row[x] == 'S' ? 'a' : row[x] == 'E' ? 'z' : row[x]) - 'a');
         }
+        heightmap.height++;
+    }
+    mapped_close(&mapped);
+
+    long check_start_count = -1, check_lowest_count = -1;
+    if (check and not reverse_grid_counts(&heightmap, &check_start_count, &check_lowest_count)) {
+        fprintf(stderr, "could not allocate the generic search of a %zux%zu heightmap\n", heightmap.width,
+                heightmap.height);
+        return EXIT_FAILURE;
+    }
+
+    long start_count, lowest_count;
+    if (not reverse_bfs(&heightmap, &start_count, &lowest_count)) {
+        fprintf(stderr, "could not allocate the search of a %zux%zu heightmap\n", heightmap.width, heightmap.height);
+        return EXIT_FAILURE;
+    }
+    if (check and (start_count != check_start_count or lowest_count != check_lowest_count)) {
+        fprintf(stderr, "the generic search found %ld and %ld steps instead of %ld and %ld\n", check_start_count,
+                check_lowest_count, start_count, lowest_count);
+        return EXIT_FAILURE;
     }
 
     {
@@ -201,9 +181,8 @@ int main(int argc, char *argv[]) {
         printf("What is the fewest steps required to move from your current position to the location that should get "
                "the best signal?\n");
 
-        int count = a_star(&heightmap, start_p, end_p);
-
-        printf("The fewest steps required to move from your current position to the location is %d steps\n", count);
+        printf("The fewest steps required to move from your current position to the location is %ld steps\n",
+               start_count);
     }
 
     {
@@ -211,37 +190,12 @@ int main(int argc, char *argv[]) {
         printf("What is the fewest steps required to move starting from any square with elevation a to the location "
                "that should get the best signal?\n");
 
-        vec2i_array lowest_elevations = {0, 0, NULL};
-        for (int y = 0; y < (int)heightmap.height; ++y) {
-            for (int x = 0; x < (int)heightmap.width; ++x) {
-                if ((char)height_at(&heightmap, vec2i(x, y)) + 'a' == 'a') {
-                    vec2i_array_append(&lowest_elevations, vec2i(x, y));
-                }
-            }
-        }
-
-        int minimum_count = 0;
-        for (size_t i = 0; i < lowest_elevations.len; ++i) {
-            int count = a_star(&heightmap, lowest_elevations.data[i], end_p);
-            if (count == -1) {
-                continue;
-            }
-
-            if (minimum_count == 0 or count < minimum_count) {
-                minimum_count = count;
-            }
-            printf("search %2.0f%% complete\r", (float)i / (float)(lowest_elevations.len - 1) * 100.0);
-            fflush(stdout);
-        }
-
-        vec2i_array_free(&lowest_elevations);
-
-        printf("The fewest steps required to move from any square with elevation a to the location is %d steps\n",
-               minimum_count);
+        printf("The fewest steps required to move from any square with elevation a to the location is %ld steps\n",
+               lowest_count);
     }
-    int_array_free(&heightmap.heights);
 
-    free(line);
+    free(heightmap.heights);
+
     if (fptr != stdin) {
         fclose(fptr);
     }
@@ -1,191 +1,284 @@
 #include <errno.h>
 #include <iso646.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "array.h"
 #include "helpers.h"
+#include "mapped.h"
+#include "sort.h"
 
-typedef struct packet_t packet_t;
-struct packet_t {
-    packet_t *parent;
-    packet_t *next;
-    packet_t *child;
-    int *value;
-};
-
-packet_t *new_packet(packet_t *parent) {
-    packet_t *node = malloc(sizeof(packet_t));
-    node->parent = parent;
-    node->next = NULL;
-    node->child = NULL;
-    node->value = NULL;
-    return node;
-}
+ARRAY(const char *, line_array)
+ARRAY(uint8_t, byte_array)
 
-packet_t *divider_packet(int value) {
-    packet_t *divider_packet = new_packet(NULL);
-    divider_packet->child = new_packet(divider_packet);
-    divider_packet->child->child = new_packet(divider_packet);
-    divider_packet->child->child->value = malloc(sizeof(int));
-    *divider_packet->child->child->value = value;
-    return divider_packet;
-}
+typedef enum { OPEN, CLOSE, NUMBER, END } token_t;
 
-ARRAY(packet_t *, packet_array)
+typedef struct {
+    const char *p;
+    size_t pending;
+    bool closing;
+} cursor_t;
 
-void print_node(const packet_t *node) {
-    if (not node) {
-        return;
+token_t cursor_peek(cursor_t *cursor) {
+    if (cursor->closing) {
+        return CLOSE;
     }
-
-    if (node->child) {
-        printf("[");
-        print_node(node->child);
-        printf("]");
+    while (*cursor->p == ',') {
+        cursor->p++;
     }
-
-    if (node->value) {
-        printf("%d", *node->value);
+    switch (*cursor->p) {
+    case '[':
+        return OPEN;
+    case ']':
+        return CLOSE;
+    default:
+        return *cursor->p >= '0' and *cursor->p <= '9' ? NUMBER : END;
     }
+}
 
-    if (node->next) {
-        printf(", ");
-        print_node(node->next);
+void cursor_next(cursor_t *cursor) {
+    if (cursor->closing) {
+        cursor->closing = --cursor->pending > 0;
+        return;
     }
+    cursor->p++;
 }
 
-void delete_nodes(packet_t *node) {
-    if (not node) {
-        return;
+int cursor_number_cmp(cursor_t *left, cursor_t *right) {
+    while (*left->p == '0' and left->p[1] >= '0' and left->p[1] <= '9') {
+        left->p++;
+    }
+    while (*right->p == '0' and right->p[1] >= '0' and right->p[1] <= '9') {
+        right->p++;
     }
 
-    if (node->value) {
-        free(node->value);
+    size_t left_len = 0, right_len = 0;
+    while (left->p[left_len] >= '0' and left->p[left_len] <= '9') {
+        left_len++;
+    }
+    while (right->p[right_len] >= '0' and right->p[right_len] <= '9') {
+        right_len++;
     }
 
-    delete_nodes(node->child);
-    delete_nodes(node->next);
+    int cmp = left_len != right_len ? (left_len < right_len ? -1 : 1) : memcmp(left->p, right->p, left_len);
 
-    free(node);
+    left->p += left_len;
+    left->closing = left->pending > 0;
+    right->p += right_len;
+    right->closing = right->pending > 0;
+    return cmp;
 }
 
-typedef enum { RIGHT, NOT_RIGHT, UNK } cmp;
-cmp packet_cmp(packet_t *left, packet_t *right) {
-    if (not left and right) {
-        return RIGHT;
+// compares two packets straight from their text, an integer facing a list is promoted by letting its cursor emit the
+// matching closing brackets right after the integer, returns < 0 when left comes first
+int packet_text_cmp(const char *left, const char *right) {
+    cursor_t l = {left, 0, false}, r = {right, 0, false};
+    while (true) {
+        token_t lt = cursor_peek(&l), rt = cursor_peek(&r);
+        if (lt == END or rt == END) {
+            return lt == rt ? 0 : lt == END ? -1 : 1;
+        }
+
+        if (lt == rt and lt != NUMBER) {
+            cursor_next(&l);
+            cursor_next(&r);
+        } else if (lt == NUMBER and rt == NUMBER) {
+            int cmp = cursor_number_cmp(&l, &r);
+            if (cmp != 0) {
+                return cmp < 0 ? -1 : 1;
+            }
+        } else if (lt == CLOSE) {
+            return -1;
+        } else if (rt == CLOSE) {
+            return 1;
+        } else if (lt == NUMBER) {
+            cursor_next(&r);
+            l.pending++;
+        } else {
+            cursor_next(&l);
+            r.pending++;
+        }
     }
+}
 
-    if (left and not right) {
-        return NOT_RIGHT;
+// a packet is cut into segments, each being the opens before a leaf, the leaf (an integer or an empty list) and the
+// closes after it. Integers compare by value then by opens - closes, empty lists by opens then by reversed closes and
+// sort before integers, which gives a byte key whose memcmp order is the packet order.
+enum { EMPTY_LEAF = 1, NUMBER_LEAF = 2 };
+
+typedef struct {
+    bool pending, empty;
+    const char *digits;
+    uint16_t n_digits;
+    uint32_t opens, closes;
+} segment_t;
+
+static inline void append_u32(byte_array *key, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        byte_array_append(key, (uint8_t)(value >> shift));
     }
+}
 
-    if (not left and not right) {
-        return UNK;
+void segment_flush(byte_array *key, segment_t *segment) {
+    if (not segment->pending) {
+        return;
     }
 
-    if (left->value and right->value) {
-        if (*left->value < *right->value) {
-            return RIGHT;
-        } else if (*left->value > *right->value) {
-            return NOT_RIGHT;
-        } else {
-            return packet_cmp(left->next, right->next);
+    if (segment->empty) {
+        byte_array_append(key, EMPTY_LEAF);
+        append_u32(key, segment->opens);
+        append_u32(key, UINT32_MAX - segment->closes);
+    } else {
+        byte_array_append(key, NUMBER_LEAF);
+        byte_array_append(key, (uint8_t)(segment->n_digits >> 8));
+        byte_array_append(key, (uint8_t)segment->n_digits);
+        for (uint16_t i = 0; i < segment->n_digits; ++i) {
+            byte_array_append(key, (uint8_t)segment->digits[i]);
         }
+        append_u32(key, (uint32_t)((int64_t)segment->opens - (int64_t)segment->closes + INT32_MAX));
     }
+    segment->pending = false;
+}
 
-    if (left->value and right->child) {
-        left->child = new_packet(left);
-        left->child->value = left->value;
-        left->value = NULL;
-    } else if (left->child and right->value) {
-        right->child = new_packet(right);
-        right->child->value = right->value;
-        right->value = NULL;
-    }
+void packet_key(byte_array *key, const char *c) {
+    segment_t segment = {false, false, NULL, 0, 0, 0};
+    uint32_t opens = 0;
+    for (; *c != '\n'; ++c) {
+        if (*c == ']') {
+            segment.closes++;
+            continue;
+        }
+        if (*c == ',') {
+            continue;
+        }
 
-    if (not left->value and right->value) {
-        return RIGHT;
-    } else if (left->value and not right->value) {
-        return NOT_RIGHT;
-    }
+        segment_flush(key, &segment);
+        if (*c == '[' and c[1] != ']') {
+            opens++;
+            continue;
+        }
 
-    cmp child = packet_cmp(left->child, right->child);
-    if (child != UNK) {
-        return child;
+        segment_t leaf = {true, *c == '[', NULL, 0, opens, 0};
+        if (leaf.empty) {
+            ++c;
+        } else {
+            while (*c == '0' and c[1] >= '0' and c[1] <= '9') {
+                ++c;
+            }
+            leaf.digits = c;
+            while (c[1] >= '0' and c[1] <= '9') {
+                ++c;
+            }
+            leaf.n_digits = (uint16_t)(c - leaf.digits + 1);
+        }
+        segment = leaf;
+        opens = 0;
     }
+    segment_flush(key, &segment);
+}
 
-    return packet_cmp(left->next, right->next);
+// a packet key points into the shared key bytes once they are all built
+typedef struct {
+    const uint8_t *bytes;
+    size_t len;
+    const char *line;
+} packet_key_t;
+
+ARRAY(packet_key_t, packet_key_array)
+
+static inline int key_cmp(packet_key_t a, packet_key_t b) {
+    int cmp = memcmp(a.bytes, b.bytes, a.len < b.len ? a.len : b.len);
+    return cmp != 0 ? cmp : (a.len > b.len) - (a.len < b.len);
 }
 
-void sort_packet_array(packet_array *array) {
-    for (size_t i = 0; i < array->len - 1; ++i) {
-        for (size_t j = 0; j < array->len - i - 1; ++j) {
-            if (packet_cmp(array->data[j], array->data[j + 1]) == NOT_RIGHT) {
-                packet_t *tmp = array->data[j];
-                array->data[j] = array->data[j + 1];
-                array->data[j + 1] = tmp;
-            }
+#define KEY_LESS(a, b) (key_cmp(a, b) < 0)
+
+SORT(packet_key_t, packet_key, KEY_LESS)
+
+typedef struct {
+    packet_key_t *keys, *tmp;
+    size_t begin, middle, end;
+} sort_job_t;
+
+void *sort_job(void *arg) {
+    sort_job_t *job = arg;
+    if (job->middle == job->begin) {
+        packet_key_stable_sort(job->keys + job->begin, job->tmp + job->begin, job->end - job->begin);
+    } else {
+        packet_key_merge(job->keys + job->begin, job->middle - job->begin, job->keys + job->middle,
+                         job->end - job->middle, job->tmp + job->begin);
+        memcpy(job->keys + job->begin, job->tmp + job->begin, (job->end - job->begin) * sizeof(packet_key_t));
+    }
+    return NULL;
+}
+
+// each thread sorts a run, then runs are merged pairwise, one thread per pair, until one is left
+void key_parallel_sort(packet_key_t *keys, size_t n, size_t n_threads) {
+    packet_key_t *tmp = calloc(n, sizeof(packet_key_t));
+    pthread_t *threads = calloc(n_threads, sizeof(pthread_t));
+    sort_job_t *jobs = calloc(n_threads, sizeof(sort_job_t));
+
+    size_t run = (n + n_threads - 1) / n_threads;
+    run = run > 0 ? run : 1;
+    for (size_t width = run, merging = 0; merging == 0 or width / 2 < n; width *= 2, merging = 1) {
+        size_t n_jobs = 0;
+        for (size_t begin = 0; begin < n; begin += width) {
+            size_t end = begin + width < n ? begin + width : n;
+            size_t middle = merging ? (begin + width / 2 < end ? begin + width / 2 : end) : begin;
+            sort_job_t job = {keys, tmp, begin, middle, end};
+            jobs[n_jobs] = job;
+            pthread_create(&threads[n_jobs], NULL, sort_job, &jobs[n_jobs]);
+            n_jobs++;
+        }
+        for (size_t i = 0; i < n_jobs; ++i) {
+            pthread_join(threads[i], NULL);
         }
     }
+
+    free(jobs);
+    free(threads);
+    free(tmp);
 }
 
 int usage(const char *name) {
-    printf("usage: %s input\n", name);
+    printf("usage: %s [--sorted] input\n", name);
+    printf("\t--sorted: also print every packet, dividers included, in the correct order\n");
     printf("\tinput: path to input file, '-' to use stdin\n");
     return EXIT_FAILURE;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc - 1 != 1) {
+    if (argc - 1 != 1 and argc - 1 != 2) {
         return usage(argv[0]);
     }
 
-    const char *input = argv[1];
+    if (argc - 1 == 2 and not strequ(argv[1], "--sorted")) {
+        return usage(argv[0]);
+    }
+    bool sorted = argc - 1 == 2;
+
+    const char *input = argv[argc - 1];
     FILE *fptr = strequ(input, "-") ? stdin : fopen(input, "r");
     if (!fptr) {
         fprintf(stderr, "could not open %s: %s\n", input, strerror(errno));
         return EXIT_FAILURE;
     }
 
-    char *line = NULL;
-    size_t len = 0;
+    mapped_t mapped = mapped_open(fptr);
+    if (not mapped.data) {
+        fprintf(stderr, "could not read %s: %s\n", input, strerror(errno));
+        return EXIT_FAILURE;
+    }
 
-    packet_array packets = {0, 0, NULL};
-    while (getline(&line, &len, fptr) != -1) {
-        if (strequ(line, "\n")) {
+    line_array lines = {0, 0, NULL};
+    for (const char *line = mapped.data; line < mapped.data + mapped.len; line = strchr(line, '\n') + 1) {
+        if (*line == '\n') {
             continue;
         }
-
-        packet_t *current = new_packet(NULL);
-        for (char *c = line; *c != '\n'; ++c) {
-            switch (*c) {
-            case '[':
-                current->child = new_packet(current);
-                current = current->child;
-                break;
-            case ',':
-                current->next = new_packet(current->parent);
-                current = current->next;
-                break;
-            case ']':
-                current = current->parent;
-                break;
-            default:
-                if (*c >= '0' and *c <= '9') {
-                    current->value = malloc(sizeof(int));
-                    if (*c == '1' and *(c + 1) == '0') {
-                        *current->value = 10;
-                        ++c;
-                    } else {
-                        *current->value = *c - '0';
-                    }
-                }
-                break;
-            }
-        }
-
-        packet_array_append(&packets, current);
+        line_array_append(&lines, line);
     }
 
     {
@@ -194,8 +287,8 @@ int main(int argc, char *argv[]) {
                "those pairs?\n");
 
         size_t sum = 0;
-        for (size_t i = 0; i < packets.len / 2; ++i) {
-            if (packet_cmp(packets.data[2 * i], packets.data[2 * i + 1]) == RIGHT) {
+        for (size_t i = 0; i < lines.len / 2; ++i) {
+            if (packet_text_cmp(lines.data[2 * i], lines.data[2 * i + 1]) < 0) {
                 sum += (i + 1);
             }
         }
@@ -208,30 +301,47 @@ int main(int argc, char *argv[]) {
         printf(
             "Organize all of the packets into the correct order. What is the decoder key for the distress signal?\n");
 
-        packet_t *probe_2 = divider_packet(2);
-        packet_array_append(&packets, probe_2);
-        packet_t *probe_6 = divider_packet(6);
-        packet_array_append(&packets, probe_6);
+        byte_array bytes = {0, 0, NULL};
+        packet_key_array keys = {0, 0, NULL};
+        const char *dividers[2] = {"[[2]]\n", "[[6]]\n"};
+        for (size_t i = 0; i < lines.len + 2; ++i) {
+            size_t offset = bytes.len;
+            packet_key_t key = {NULL, 0, i < lines.len ? lines.data[i] : dividers[i - lines.len]};
+            packet_key(&bytes, key.line);
+            key.len = bytes.len - offset;
+            packet_key_array_append(&keys, key);
+        }
+        const uint8_t *key_bytes = bytes.data;
+        for (size_t i = 0; i < keys.len; ++i) {
+            keys.data[i].bytes = key_bytes;
+            key_bytes += keys.data[i].len;
+        }
 
-        packet_array sorted = {packets.cap, packets.len, packets.data};
-        sort_packet_array(&sorted);
+        const packet_key_t probe_2 = keys.data[lines.len], probe_6 = keys.data[lines.len + 1];
+        size_t below_2 = 0, below_6 = 0;
+        for (size_t i = 0; i < lines.len; ++i) {
+            below_2 += key_cmp(keys.data[i], probe_2) < 0;
+            below_6 += key_cmp(keys.data[i], probe_6) < 0;
+        }
+
+        printf("The decoder key for the distress signal is: %zu.\n", (below_2 + 1) * (below_6 + 2));
 
-        size_t key = 1;
-        for (size_t i = 0; i < sorted.len; ++i) {
-            if (sorted.data[i] == probe_2 or sorted.data[i] == probe_6) {
-                key *= (i + 1);
+        if (sorted) {
+            long n_processors = sysconf(_SC_NPROCESSORS_ONLN);
+            key_parallel_sort(keys.data, keys.len, n_processors > 0 ? (size_t)n_processors : 1);
+            for (size_t i = 0; i < keys.len; ++i) {
+                fwrite(keys.data[i].line, sizeof(char),
+                       (size_t)(strchr(keys.data[i].line, '\n') - keys.data[i].line) + 1, stdout);
             }
         }
 
-        printf("The decoder key for the distress signal is: %zu.\n", key);
+        packet_key_array_free(&keys);
+        byte_array_free(&bytes);
     }
 
-    for (size_t i = 0; i < packets.len; ++i) {
-        delete_nodes(packets.data[i]);
-    }
-    packet_array_free(&packets);
+    line_array_free(&lines);
+    mapped_close(&mapped);
 
-    free(line);
     if (fptr != stdin) {
         fclose(fptr);
     }
@@ -1,122 +1,232 @@
 #include <errno.h>
 #include <iso646.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
 
 #include <ncurses.h>
 
 #include "array.h"
 #include "helpers.h"
+#include "stack.h"
 #include "vec2i.h"
 
 ARRAY(vec2i_t, vec2i_array)
+STACK(vec2i_t, vec2i_stack)
 
 typedef enum { SAND_SOURCE = '+', ROCK = '#', AIR = '.', SAND = 'o' } point_type;
-typedef struct {
-    vec2i_t p;
-    point_type t;
-} point_t;
 
-ARRAY(point_t, point_array)
+#define TILE_SIZE 64
+
+typedef struct {
+    vec2i_t origin;
+    uint8_t *cells;
+} tile_t;
 
+// cells live either in one dense row major array or, for sparse caves, in tiles allocated on their first write
 typedef struct {
     vec2i_t min, max;
     vec2i_t source;
-    point_array points;
+    int floor;
+    size_t width;
+    uint8_t *cells;
+    size_t tiles_cap, tiles_len;
+    tile_t *tiles;
+    vec2i_array *dirty;
 } map_t;
 
+static const uint8_t air = AIR, rock = ROCK;
+
+// large boxes holding few rocks are stored in tiles
+bool is_sparse(vec2i_t min, vec2i_t max, size_t n_rocks) {
+    uint64_t area = (uint64_t)((int64_t)max.x - min.x + 1) * (uint64_t)((int64_t)max.y - min.y + 1);
+    return area > (1 << 24) and area / 64 > n_rocks;
+}
+
+void map_free(map_t *m) {
+    for (size_t i = 0; i < m->tiles_cap; ++i) {
+        free(m->tiles[i].cells);
+    }
+    free(m->tiles);
+    free(m->cells);
+}
+
 bool in(const map_t *m, vec2i_t p) {
     return (p.x >= m->min.x and p.x <= m->max.x) and (p.y >= m->min.y and p.y <= m->max.y);
 }
 
-point_t *at(const map_t *m, vec2i_t p) {
+static inline size_t tile_hash(vec2i_t origin, size_t cap) {
+    uint64_t key = (uint64_t)(uint32_t)origin.x << 32 | (uint32_t)origin.y;
+    return (size_t)((key * UINT64_C(0x9e3779b97f4a7c15)) >> 32) & (cap - 1);
+}
+
+static inline size_t tile_slot(const map_t *m, vec2i_t origin) {
+    size_t h = tile_hash(origin, m->tiles_cap);
+    while (m->tiles[h].cells and not vec2i_equ(m->tiles[h].origin, origin)) {
+        h = (h + 1) & (m->tiles_cap - 1);
+    }
+    return h;
+}
+
+tile_t *map_tile(map_t *m, vec2i_t origin) {
+    if (2 * (m->tiles_len + 1) > m->tiles_cap) {
+        size_t previous_cap = m->tiles_cap;
+        tile_t *previous_tiles = m->tiles;
+
+        m->tiles_cap *= 2;
+        m->tiles = calloc(m->tiles_cap, sizeof(tile_t));
+        for (size_t i = 0; i < previous_cap; ++i) {
+            if (previous_tiles[i].cells) {
+                m->tiles[tile_slot(m, previous_tiles[i].origin)] = previous_tiles[i];
+            }
+        }
+        free(previous_tiles);
+    }
+
+    tile_t *tile = &m->tiles[tile_slot(m, origin)];
+    if (not tile->cells) {
+        tile->origin = origin;
+        tile->cells = malloc(TILE_SIZE * TILE_SIZE);
+        memset(tile->cells, AIR, TILE_SIZE * TILE_SIZE);
+        m->tiles_len++;
+    }
+    return tile;
+}
+
+static inline vec2i_t tile_origin(const map_t *m, vec2i_t p) {
+    return vec2i((p.x - m->min.x) / TILE_SIZE, (p.y - m->min.y) / TILE_SIZE);
+}
+
+static inline size_t tile_offset(const map_t *m, vec2i_t p) {
+    return (size_t)((p.x - m->min.x) % TILE_SIZE + (p.y - m->min.y) % TILE_SIZE * TILE_SIZE);
+}
+
+static inline size_t dense_offset(const map_t *m, vec2i_t p) {
+    return (size_t)((int64_t)p.x - m->min.x) + (size_t)((int64_t)p.y - m->min.y) * m->width;
+}
+
+const uint8_t *at(const map_t *m, vec2i_t p) {
     if (not in(m, p)) {
         return NULL;
     }
+    if (p.y == m->floor) {
+        return &rock;
+    }
+    if (m->cells) {
+        return &m->cells[dense_offset(m, p)];
+    }
 
-    int i = p.y - m->min.y, j = p.x - m->min.x, w = abs(m->max.x - m->min.x) + 1;
-    return &m->points.data[j + i * w];
+    const tile_t *tile = &m->tiles[tile_slot(m, tile_origin(m, p))];
+    return tile->cells ? &tile->cells[tile_offset(m, p)] : &air;
 }
 
-void resize(map_t *m, vec2i_t min, vec2i_t max) {
-    point_array previous_points = m->points, points = {0, 0, NULL};
+void map_set(map_t *m, vec2i_t p, uint8_t value) {
+    if (m->dirty and *at(m, p) != value) {
+        vec2i_array_append(m->dirty, p);
+    }
 
-    m->min = min;
-    m->max = max;
-    for (int y = m->min.y; y < m->max.y + 1; ++y) {
-        for (int x = m->min.x; x < m->max.x + 1; ++x) {
-            vec2i_t p = vec2i(x, y);
-            point_t point = {p, vec2i_equ(p, m->source) ? SAND_SOURCE : y == m->max.y ? ROCK : AIR};
-            point_array_append(&points, point);
-        }
+    if (m->cells) {
+        m->cells[dense_offset(m, p)] = value;
+    } else {
+        map_tile(m, tile_origin(m, p))->cells[tile_offset(m, p)] = value;
     }
-    m->points = points;
+}
 
-    for (size_t i = 0; i < previous_points.len; ++i) {
-        point_t *point = at(m, previous_points.data[i].p);
-        if (not point) {
-            continue;
+// both cells and tiles are NULL when the storage could not be allocated, a dense box too large to address included
+map_t map_new(vec2i_t min, vec2i_t max, vec2i_t source, int floor, bool sparse) {
+    map_t m = {min, max, source, floor, (size_t)((int64_t)max.x - min.x + 1), NULL, 0, 0, NULL, NULL};
+    size_t area;
+    if (sparse) {
+        m.tiles_cap = 1024;
+        m.tiles = calloc(m.tiles_cap, sizeof(tile_t));
+    } else if (not __builtin_mul_overflow(m.width, (size_t)((int64_t)max.y - min.y + 1), &area) and
+               area <= PTRDIFF_MAX) {
+        m.cells = malloc(area);
+        if (m.cells) {
+            memset(m.cells, AIR, area);
         }
-        point->t = previous_points.data[i].t;
     }
-
-    point_array_free(&previous_points);
+    if (not m.cells and not m.tiles) {
+        return m;
+    }
+    if (in(&m, source)) {
+        map_set(&m, source, SAND_SOURCE);
+    }
+    return m;
 }
 
-void ncurses_draw(const map_t *m, vec2i_t offset) {
-    clear();
+void ncurses_init(void) {
+    initscr();
+    start_color();
 
-    size_t sand_count = 0;
-    vec2i_t start_win = {(COLS - (m->max.x - m->min.x)) / 2, (LINES - (m->max.y - m->min.y)) / 2};
-    for (int y = m->min.y; y < m->max.y + 1; ++y) {
-        for (int x = m->min.x; x < m->max.x + 1; ++x) {
-            point_t *point = at(m, vec2i(x, y));
-            if (point->t == SAND) {
-                sand_count++;
-                attron(COLOR_PAIR(1));
-            }
+    init_color(COLOR_YELLOW, 900, 800, 600);
+    init_pair(1, COLOR_YELLOW, COLOR_BLACK);
 
-            switch (point->t) {
-            case SAND:
-                attron(COLOR_PAIR(1));
-                break;
-            case ROCK:
-                attron(COLOR_PAIR(2));
-                break;
-            case SAND_SOURCE:
-            case AIR:
-            default:
-                break;
-            }
+    init_color(COLOR_RED, 500, 250, 250);
+    init_pair(2, COLOR_RED, COLOR_BLACK);
 
-            mvprintw(start_win.y + y - m->min.y + offset.y, start_win.x + x - m->min.x + offset.x, "%c", point->t);
+    cbreak();
+    noecho();
+    curs_set(0);
+    keypad(stdscr, true);
+    timeout(0);
+}
 
-            switch (point->t) {
-            case SAND:
-                attroff(COLOR_PAIR(1));
-                break;
-            case ROCK:
-                attroff(COLOR_PAIR(2));
-                break;
-            case SAND_SOURCE:
-            case AIR:
-            default:
-                break;
+void ncurses_draw_cell(const map_t *m, vec2i_t origin, vec2i_t p) {
+    uint8_t cell = *at(m, p);
+    short pair = cell == SAND ? 1 : cell == ROCK ? 2 : 0;
+
+    if (pair) {
+        attron(COLOR_PAIR(pair));
+    }
+    mvaddch(origin.y + p.y - m->min.y, origin.x + p.x - m->min.x, cell);
+    if (pair) {
+        attroff(COLOR_PAIR(pair));
+    }
+}
+
+// only the cells written since the last frame are drawn again, unless full asks for the whole map
+void ncurses_draw(const map_t *m, vec2i_t offset, bool full, size_t units) {
+    vec2i_t origin = {(COLS - (m->max.x - m->min.x)) / 2 + offset.x, (LINES - (m->max.y - m->min.y)) / 2 + offset.y};
+
+    if (full) {
+        erase();
+        for (int y = m->min.y; y < m->max.y + 1; ++y) {
+            for (int x = m->min.x; x < m->max.x + 1; ++x) {
+                ncurses_draw_cell(m, origin, vec2i(x, y));
             }
         }
+    } else {
+        for (size_t i = 0; i < m->dirty->len; ++i) {
+            ncurses_draw_cell(m, origin, m->dirty->data[i]);
+        }
     }
-    mvprintw(start_win.y + m->max.y + 1 + offset.y, start_win.x + offset.x, "%zu units of sand", sand_count);
+    m->dirty->len = 0;
+
+    mvprintw(origin.y + m->max.y - m->min.y + 1, origin.x, "%zu units of sand", units);
     refresh();
 }
 
-size_t count_sand(const map_t *m) {
-    size_t count = 0;
-    for (size_t i = 0; i < m->points.len; ++i) {
-        if (m->points.data[i].t == SAND) {
-            count++;
+bool dump_frame(const map_t *m, const char *dir, const char *part, size_t frame) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s_%06zu.txt", dir, part, frame);
+    FILE *fptr = fopen(path, "w");
+    if (not fptr) {
+        fprintf(stderr, "could not open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    for (int y = m->min.y; y < m->max.y + 1; ++y) {
+        for (int x = m->min.x; x < m->max.x + 1; ++x) {
+            fputc(*at(m, vec2i(x, y)), fptr);
         }
+        fputc('\n', fptr);
     }
-    return count;
+    fclose(fptr);
+    return true;
 }
 
 typedef struct {
@@ -130,16 +240,16 @@ bool update(map_t *map, sand_t *current) {
 
     for (size_t i = 0; i < 3; ++i) {
         vec2i_t candidate = vec2i_add(current->p, directions[i]);
-        point_t *point = at(map, candidate);
-        if (not point) {
-            at(map, current->p)->t = AIR;
+        const uint8_t *cell = at(map, candidate);
+        if (not cell) {
+            map_set(map, current->p, AIR);
             return false;
         }
-        if (point->t == AIR) {
-            at(map, current->p)->t = not vec2i_equ(current->p, map->source) ? AIR : SAND_SOURCE;
+        if (*cell == AIR) {
+            map_set(map, current->p, not vec2i_equ(current->p, map->source) ? AIR : SAND_SOURCE);
             current->p = candidate;
             current->at_rest = false;
-            at(map, current->p)->t = SAND;
+            map_set(map, current->p, SAND);
             return true;
         }
     }
@@ -148,22 +258,254 @@ bool update(map_t *map, sand_t *current) {
     return true;
 }
 
+// moves the falling grain by one cell, returns false once a grain falls out of the map or comes to rest on the source
+bool step(map_t *map, sand_t *sand, size_t *units) {
+    if (not update(map, sand)) {
+        return false;
+    }
+
+    if (sand->at_rest) {
+        (*units)++;
+        if (vec2i_equ(sand->p, map->source)) {
+            return false;
+        }
+        sand->p = map->source;
+        sand->at_rest = false;
+        map_set(map, sand->p, SAND);
+    }
+    return true;
+}
+
+// drops one grain starting from the end of the path of the previous one, which is still open except for the cell
+// where that grain came to rest, returns false when the grain falls out of the map or the source is blocked
+bool drop(map_t *map, vec2i_stack *path) {
+    const vec2i_t directions[3] = {south, south_west, south_east};
+
+    while (path->len > 0) {
+        vec2i_t p = vec2i_stack_top(path);
+
+        size_t i = 0;
+        for (; i < 3; ++i) {
+            const uint8_t *cell = at(map, vec2i_add(p, directions[i]));
+            if (not cell) {
+                return false;
+            }
+            if (*cell == AIR) {
+                break;
+            }
+        }
+
+        if (i == 3) {
+            map_set(map, p, SAND);
+            vec2i_stack_pop(path);
+            return true;
+        }
+        vec2i_stack_push(path, vec2i_add(p, directions[i]));
+    }
+
+    return false;
+}
+
+static inline bool reached(const map_t *map, vec2i_t p) {
+    const uint8_t *cell = at(map, p);
+    return cell and (*cell == SAND or *cell == SAND_SOURCE);
+}
+
+// with a floor, sand ends up in every open cell having one of the three cells above it filled, so the rows below
+// the source are filled top down without simulating any grain
+size_t fill(map_t *map) {
+    size_t units = 1;
+    map_set(map, map->source, SAND);
+
+    for (int y = map->source.y + 1; y < map->max.y; ++y) {
+        int spread = y - map->source.y;
+        for (int x = map->source.x - spread; x <= map->source.x + spread; ++x) {
+            const uint8_t *cell = at(map, vec2i(x, y));
+            if (cell and *cell == AIR and
+                (reached(map, vec2i(x - 1, y - 1)) or reached(map, vec2i(x, y - 1)) or
+                 reached(map, vec2i(x + 1, y - 1)))) {
+                map_set(map, vec2i(x, y), SAND);
+                units++;
+            }
+        }
+    }
+
+    return units;
+}
+
+typedef enum { STEP, RESUME, FILL } engine_t;
+
+typedef enum { AUTOMATIC, DENSE, SPARSE } storage_t;
+
+typedef struct {
+    bool display;
+    engine_t engine;
+    storage_t storage;
+    size_t steps_per_frame;
+    unsigned fps;
+    const char *frames;
+} options_t;
+
+bool use_sparse(const options_t *options, vec2i_t min, vec2i_t max, size_t n_rocks) {
+    return options->storage == SPARSE or (options->storage == AUTOMATIC and is_sparse(min, max, n_rocks));
+}
+
+static inline long elapsed_ns(struct timespec since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since.tv_sec) * 1000000000L + (now.tv_nsec - since.tv_nsec);
+}
+
+// runs the step engine, a frame being drawn or dumped every steps_per_frame steps, displayed frames stay at most fps
+void animate(map_t *map, const options_t *options, const char *part, size_t *units) {
+    vec2i_array dirty = {0, 0, NULL};
+    if (options->display) {
+        map->dirty = &dirty;
+        ncurses_init();
+    }
+
+    sand_t sand = {map->source, false};
+    map_set(map, sand.p, SAND);
+
+    size_t frame = 0;
+    if (options->frames) {
+        dump_frame(map, options->frames, part, frame++);
+    }
+
+    vec2i_t offset = {0, 0};
+    bool running = true, pause = options->display, full = true;
+    for (int ch = 0; options->display ? ch != 'q' : running;) {
+        struct timespec frame_start;
+        clock_gettime(CLOCK_MONOTONIC, &frame_start);
+
+        if (options->display) {
+            switch (ch = getch()) {
+            case 'w':
+                offset = vec2i_add(offset, vec2i(0, +1));
+                full = true;
+                break;
+            case 'a':
+                offset = vec2i_add(offset, vec2i(-1, 0));
+                full = true;
+                break;
+            case 's':
+                offset = vec2i_add(offset, vec2i(0, -1));
+                full = true;
+                break;
+            case 'd':
+                offset = vec2i_add(offset, vec2i(+1, 0));
+                full = true;
+                break;
+            case KEY_RESIZE:
+                full = true;
+                break;
+            case ' ':
+                pause = not pause;
+                break;
+            default:
+                break;
+            }
+        }
+
+        if (running and not pause) {
+            for (size_t i = 0; i < options->steps_per_frame and running; ++i) {
+                running = step(map, &sand, units);
+            }
+            if (options->frames) {
+                dump_frame(map, options->frames, part, frame++);
+            }
+        }
+
+        if (options->display) {
+            ncurses_draw(map, offset, full, *units);
+            full = false;
+
+            long remaining = options->fps > 0 ? 1000000000L / options->fps - elapsed_ns(frame_start) : 0;
+            if (remaining > 0) {
+                struct timespec pause_time = {remaining / 1000000000L, remaining % 1000000000L};
+                nanosleep(&pause_time, NULL);
+            }
+        }
+    }
+
+    if (options->display) {
+        endwin();
+        map->dirty = NULL;
+    }
+    vec2i_array_free(&dirty);
+}
+
+void add_rocks(map_t *map, const vec2i_array *rocks) {
+    for (size_t i = 0; i < rocks->len; ++i) {
+        if (in(map, rocks->data[i])) {
+            map_set(map, rocks->data[i], ROCK);
+        }
+    }
+}
+
 int usage(const char *name) {
-    printf("usage: %s [-d] input\n", name);
+    printf("usage: %s [-d] [--engine step|resume|fill] [--storage dense|sparse] [--steps n] [--fps n] [--frames dir] "
+           "input\n",
+           name);
     printf("\t-d: toggle to display ncurses animation, absence means no display\n");
+    printf("\t--engine: step moves one grain by one cell at a time, resume restarts each grain where the previous one "
+           "last had room, fill also computes part two row by row, absence means fill, -d and --frames always step\n");
+    printf("\t--storage: cells in one array or in tiles allocated on first write, absence means sparse for large boxes "
+           "holding few rocks\n");
+    printf("\t--steps: simulation steps between two frames, absence means 1\n");
+    printf("\t--fps: highest number of frames displayed per second, absence means no limit\n");
+    printf("\t--frames: directory where every frame is written as a text file\n");
     printf("\tinput: path to input file, '-' to use stdin\n");
     return EXIT_FAILURE;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc - 1 != 1 and argc - 1 != 2) {
+    if (argc - 1 < 1) {
         return usage(argv[0]);
     }
 
-    if (argc - 1 == 2 and not strequ(argv[1], "-d")) {
-        return usage(argv[0]);
+    options_t options = {false, FILL, AUTOMATIC, 1, 0, NULL};
+    for (int i = 1; i < argc - 1; ++i) {
+        if (strequ(argv[i], "-d")) {
+            options.display = true;
+        } else if (strequ(argv[i], "--engine") and i + 1 < argc - 1) {
+            ++i;
+            if (strequ(argv[i], "step")) {
+                options.engine = STEP;
+            } else if (strequ(argv[i], "resume")) {
+                options.engine = RESUME;
+            } else if (strequ(argv[i], "fill")) {
+                options.engine = FILL;
+            } else {
+                return usage(argv[0]);
+            }
+        } else if (strequ(argv[i], "--storage") and i + 1 < argc - 1) {
+            ++i;
+            if (strequ(argv[i], "dense")) {
+                options.storage = DENSE;
+            } else if (strequ(argv[i], "sparse")) {
+                options.storage = SPARSE;
+            } else {
+                return usage(argv[0]);
+            }
+        } else if (strequ(argv[i], "--steps") and i + 1 < argc - 1) {
+            if (sscanf(argv[++i], "%zu", &options.steps_per_frame) != 1 or options.steps_per_frame == 0) {
+                return usage(argv[0]);
+            }
+        } else if (strequ(argv[i], "--fps") and i + 1 < argc - 1) {
+            if (sscanf(argv[++i], "%u", &options.fps) != 1) {
+                return usage(argv[0]);
+            }
+        } else if (strequ(argv[i], "--frames") and i + 1 < argc - 1) {
+            options.frames = argv[++i];
+            if (mkdir(options.frames, 0755) != 0 and errno != EEXIST) {
+                fprintf(stderr, "could not create %s: %s\n", options.frames, strerror(errno));
+                return EXIT_FAILURE;
+            }
+        } else {
+            return usage(argv[0]);
+        }
     }
-    bool display = argc - 1 == 2 and strequ(argv[1], "-d");
 
     const char *input = argv[argc - 1];
     FILE *fptr = strequ(input, "-") ? stdin : fopen(input, "r");
@@ -213,106 +555,33 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    const int frametime = 0;
+    const bool animated = options.display or options.frames or options.engine == STEP;
     {
         printf("--- Part One ---\n");
         printf("Using your scan, simulate the falling sand. How many units of sand come to rest before sand starts "
                "flowing "
                "into the abyss below?\n");
 
-        if (display) {
-            initscr();
-            start_color();
-
-            init_color(COLOR_YELLOW, 900, 800, 600);
-            init_pair(1, COLOR_YELLOW, COLOR_BLACK);
-
-            init_color(COLOR_RED, 500, 250, 250);
-            init_pair(2, COLOR_RED, COLOR_BLACK);
-
-            cbreak();
-            noecho();
-            curs_set(0);
-            timeout(frametime);
-        }
-
-        map_t map = {min, max, sand_source, {0, 0, NULL}};
-        for (int y = map.min.y; y < map.max.y + 1; ++y) {
-            for (int x = map.min.x; x < map.max.x + 1; ++x) {
-                vec2i_t p = vec2i(x, y);
-                point_t point = {p, vec2i_equ(p, map.source) ? SAND_SOURCE : AIR};
-                point_array_append(&map.points, point);
-            }
-        }
-
-        for (size_t i = 0; i < rocks.len; ++i) {
-            point_t *point = at(&map, rocks.data[i]);
-            if (not point) {
-                continue;
-            }
-            point->t = ROCK;
-        }
-
-        int ch;
-        bool should_update = true, pause = true;
-        const vec2i_t sand_start = sand_source;
-        sand_t sand = {sand_start, false};
-        at(&map, sand.p)->t = SAND;
-
-        vec2i_t offset = {0, 0};
-        if (display) {
-            ncurses_draw(&map, offset);
+        map_t map = map_new(min, max, sand_source, INT_MAX, use_sparse(&options, min, max, rocks.len));
+        if (not map.cells and not map.tiles) {
+            fprintf(stderr, "could not allocate the cave %d,%d..%d,%d\n", min.x, min.y, max.x, max.y);
+            return EXIT_FAILURE;
         }
+        add_rocks(&map, &rocks);
 
         size_t units = 0;
-        if (display) {
-            while ((ch = getch()) != 'q') {
-                switch (ch) {
-                case 'w':
-                    offset = vec2i_add(offset, vec2i(0, +1));
-                    break;
-                case 'a':
-                    offset = vec2i_add(offset, vec2i(-1, 0));
-                    break;
-                case 's':
-                    offset = vec2i_add(offset, vec2i(0, -1));
-                    break;
-                case 'd':
-                    offset = vec2i_add(offset, vec2i(+1, 0));
-                    break;
-                case ' ':
-                    pause = not pause;
-                    break;
-                default:
-                    break;
-                }
-
-                if (should_update and not pause) {
-                    should_update = update(&map, &sand);
-                    if (sand.at_rest) {
-                        sand.p = sand_start;
-                        sand.at_rest = false;
-                        at(&map, sand.p)->t = SAND;
-                        units++;
-                    }
-                }
-
-                ncurses_draw(&map, offset);
-            }
-            endwin();
+        if (animated) {
+            animate(&map, &options, "one", &units);
         } else {
-            while (should_update) {
-                should_update = update(&map, &sand);
-                if (sand.at_rest) {
-                    sand.p = sand_start;
-                    sand.at_rest = false;
-                    at(&map, sand.p)->t = SAND;
-                    units++;
-                }
+            vec2i_stack path = {0, 0, NULL};
+            vec2i_stack_push(&path, sand_source);
+            while (drop(&map, &path)) {
+                units++;
             }
+            vec2i_stack_free(&path);
         }
 
-        point_array_free(&map.points);
+        map_free(&map);
 
         printf("%zu units of sand come to rest before sand starts flowing into the abyss.\n", units);
     }
@@ -322,112 +591,34 @@ int main(int argc, char *argv[]) {
         printf("Using your scan, simulate the falling sand until the source of the sand becomes blocked. How many "
                "units of sand come to rest?\n");
 
-        if (display) {
-            initscr();
-            start_color();
-
-            init_color(COLOR_YELLOW, 900, 800, 600);
-            init_pair(1, COLOR_YELLOW, COLOR_BLACK);
-
-            init_color(COLOR_RED, 500, 250, 250);
-            init_pair(2, COLOR_RED, COLOR_BLACK);
-
-            cbreak();
-            noecho();
-            curs_set(0);
-            timeout(frametime);
-        }
-
-        map_t map = {vec2i(min.x, min.y), vec2i(max.x, max.y + 2), sand_source, {0, 0, NULL}};
-        for (int y = map.min.y; y < map.max.y + 1; ++y) {
-            for (int x = map.min.x; x < map.max.x + 1; ++x) {
-                vec2i_t p = vec2i(x, y);
-                point_t point = {p, vec2i_equ(p, map.source) ? SAND_SOURCE : y == map.max.y ? ROCK : AIR};
-                point_array_append(&map.points, point);
-            }
-        }
-
-        for (size_t i = 0; i < rocks.len; ++i) {
-            point_t *point = at(&map, rocks.data[i]);
-            if (not point) {
-                continue;
-            }
-            point->t = ROCK;
-        }
-
-        int ch;
-        bool should_update = true, pause = true;
-        const vec2i_t sand_start = sand_source;
-        sand_t sand = {sand_start, false};
-        at(&map, sand.p)->t = SAND;
-
-        vec2i_t offset = {0, 0};
-        if (display) {
-            ncurses_draw(&map, offset);
+        // sand piles up in a triangle under the source, so the floor never needs to be wider than its depth
+        const int floor_y = max.y + 2;
+        vec2i_t floor_min = vec2i(sand_source.x - floor_y, min.y);
+        vec2i_t floor_max = vec2i(sand_source.x + floor_y, floor_y);
+        map_t map =
+            map_new(floor_min, floor_max, sand_source, floor_y, use_sparse(&options, floor_min, floor_max, rocks.len));
+        if (not map.cells and not map.tiles) {
+            fprintf(stderr, "could not allocate the cave %d,%d..%d,%d\n", floor_min.x, floor_min.y, floor_max.x,
+                    floor_max.y);
+            return EXIT_FAILURE;
         }
+        add_rocks(&map, &rocks);
 
-        if (display) {
-            while ((ch = getch()) != 'q') {
-                switch (ch) {
-                case 'w':
-                    offset = vec2i_add(offset, vec2i(0, +1));
-                    break;
-                case 'a':
-                    offset = vec2i_add(offset, vec2i(-1, 0));
-                    break;
-                case 's':
-                    offset = vec2i_add(offset, vec2i(0, -1));
-                    break;
-                case 'd':
-                    offset = vec2i_add(offset, vec2i(+1, 0));
-                    break;
-                case ' ':
-                    pause = not pause;
-                    break;
-                default:
-                    break;
-                }
-
-                if (should_update and not pause) {
-                    if (not update(&map, &sand)) {
-                        resize(&map, vec2i(map.min.x - 1, map.min.y), vec2i(map.max.x + 1, map.max.y));
-                        at(&map, sand.p)->t = SAND;
-                    }
-                    if (sand.at_rest) {
-                        if (vec2i_equ(sand.p, sand_source)) {
-                            should_update = false;
-                            continue;
-                        }
-
-                        sand.p = sand_start;
-                        sand.at_rest = false;
-                        at(&map, sand.p)->t = SAND;
-                    }
-                }
-
-                ncurses_draw(&map, offset);
-            }
-            endwin();
+        size_t units = 0;
+        if (animated) {
+            animate(&map, &options, "two", &units);
+        } else if (options.engine == FILL) {
+            units = fill(&map);
         } else {
-            while (should_update) {
-                if (not update(&map, &sand)) {
-                    resize(&map, vec2i(map.min.x - 1, map.min.y), vec2i(map.max.x + 1, map.max.y));
-                    at(&map, sand.p)->t = SAND;
-                }
-                if (sand.at_rest) {
-                    if (vec2i_equ(sand.p, sand_source)) {
-                        should_update = false;
-                        continue;
-                    }
-                    sand.p = sand_start;
-                    sand.at_rest = false;
-                    at(&map, sand.p)->t = SAND;
-                }
+            vec2i_stack path = {0, 0, NULL};
+            vec2i_stack_push(&path, sand_source);
+            while (drop(&map, &path)) {
+                units++;
             }
+            vec2i_stack_free(&path);
         }
-        size_t units = count_sand(&map);
 
-        point_array_free(&map.points);
+        map_free(&map);
 
         printf("%zu units of sand come to rest before sand starts flowing into the abyss.\n", units);
     }
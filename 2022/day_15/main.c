@@ -1,12 +1,16 @@
 #include <errno.h>
 #include <iso646.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/param.h>
+#include <unistd.h>
 
 #include "array.h"
 #include "helpers.h"
+#include "intervals.h"
+#include "sort.h"
 #include "vec2i.h"
 
 typedef struct {
@@ -16,10 +20,18 @@ typedef struct {
 
 ARRAY(sensor_t, sensor_array)
 ARRAY(vec2i_t, vec2i_array)
+ARRAY(int64_t, i64_array)
+ARRAY(int, int_array)
+ARRAY(size_t, size_t_array)
 
 int usage(const char *name) {
-    printf("usage: %s row input\n", name);
-    printf("\trow: row number to check\n");
+    printf("usage: %s [--engine rows|boundary] [--rows first..last|y,y,...] [--query file] row input\n", name);
+    printf("\t--engine: part two scans every row, or only tests points just outside the sensor diamonds, absence means "
+           "rows\n");
+    printf("\t--rows: rows to check in part one instead of row, as a range or a list\n");
+    printf("\t--query: instead of the puzzle, tells for each 'x,y' line whether the position is covered by a sensor "
+           "and for each 'x,y x,y' line how many sensors cover part of that rectangle\n");
+    printf("\trow: row number to check, part two searches 0..2*row\n");
     printf("\tinput: path to input file, '-' to use stdin\n");
     return EXIT_FAILURE;
 }
@@ -33,47 +45,394 @@ bool in(const vec2i_array *vs, vec2i_t v) {
     return false;
 }
 
-void sort_spans(vec2i_array *array) {
-    for (size_t i = 0; i < array->len - 1; ++i) {
-        for (size_t j = 0; j < array->len - i - 1; ++j) {
-            if (array->data[j].x > array->data[j + 1].x) {
-                vec2i_t tmp = array->data[j];
-                array->data[j] = array->data[j + 1];
-                array->data[j + 1] = tmp;
+#define SCAN_CHUNK 256
+
+typedef struct {
+    const sensor_array *sensors;
+    int limit;
+    int *next;
+    bool *found;
+    vec2i_t *beacon;
+} scanner_t;
+
+// scans chunks of rows until every row is taken or any scanner found the gap
+void *scan_rows(void *arg) {
+    scanner_t *scanner = arg;
+
+    interval_set_t spans = {0, 0, NULL};
+    int begin;
+    while (not __atomic_load_n(scanner->found, __ATOMIC_RELAXED) and
+           (begin = __atomic_fetch_add(scanner->next, SCAN_CHUNK, __ATOMIC_RELAXED)) <= scanner->limit) {
+        for (int y = begin; y < begin + SCAN_CHUNK and y <= scanner->limit; ++y) {
+            intervals_clear(&spans);
+            for (size_t i = 0; i < scanner->sensors->len; ++i) {
+                sensor_t s = scanner->sensors->data[i];
+                int d = abs(s.p.x - s.b.x) + abs(s.p.y - s.b.y) - abs(s.p.y - y);
+                intervals_push(&spans, MAX(0, s.p.x - d), MIN(scanner->limit, s.p.x + d));
+            }
+            intervals_merge(&spans);
+
+            int64_t x;
+            if (not intervals_first_gap(&spans, 0, scanner->limit, &x)) {
+                continue;
             }
+
+            bool expected = false;
+            if (__atomic_compare_exchange_n(scanner->found, &expected, true, false, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                *scanner->beacon = vec2i((int)x, y);
+            }
+            break;
         }
     }
+
+    intervals_free(&spans);
+    return NULL;
 }
 
+static inline int64_t radius(sensor_t s) { return abs(s.p.x - s.b.x) + abs(s.p.y - s.b.y); }
+
+// flipping the sign bit orders signed lines as unsigned keys
+#define LINE_KEY(line) ((uint64_t)(line) ^ (UINT64_C(1) << 63))
+
+RADIX_SORT(int64_t, line, LINE_KEY)
+
+typedef struct {
+    int64_t min_u, max_u, min_v, max_v;
+} square_t;
+
+// diamonds are squares in rotated coordinates u = x + y and v = x - y, each is listed in every bucket of a uniform
+// grid it overlaps, so a query only tests the diamonds of the buckets it falls in
 typedef struct {
-    vec2i_t left, right;
-} pair_t;
-
-pair_t merge_spans(vec2i_array *spans) {
-    pair_t unmerged = {vec2i(0, 0), vec2i(0, 0)};
-    for (size_t i = 0; i < spans->len - 1; ++i) {
-        vec2i_t *left = &spans->data[i], *right = &spans->data[i + 1];
-        if ((right->x >= left->x and right->x <= left->y) or (left->y >= right->x and left->y <= right->y) or
-            (left->y == right->x - 1)) {
-            *right = vec2i(MIN(left->x, right->x), MAX(left->y, right->y));
+    size_t n, side;
+    int64_t min_u, min_v, cell;
+    square_t *squares;
+    size_t *offsets;
+    uint32_t *entries;
+    uint32_t *stamps, stamp;
+} diamond_index_t;
+
+static inline size_t index_bucket(const diamond_index_t *index, int64_t w, int64_t min) {
+    int64_t bucket = (w - min) / index->cell;
+    return bucket < 0 ? 0 : bucket >= (int64_t)index->side ? index->side - 1 : (size_t)bucket;
+}
+
+diamond_index_t index_new(const sensor_array *sensors) {
+    diamond_index_t index = {sensors->len, 1, 0, 0, 1, NULL, NULL, NULL, NULL, 0};
+    index.squares = calloc(sensors->len + 1, sizeof(square_t));
+    index.stamps = calloc(sensors->len + 1, sizeof(uint32_t));
+
+    int64_t max_u = 0, max_v = 0;
+    for (size_t i = 0; i < sensors->len; ++i) {
+        sensor_t s = sensors->data[i];
+        int64_t u = (int64_t)s.p.x + s.p.y, v = (int64_t)s.p.x - s.p.y, r = radius(s);
+        square_t square = {u - r, u + r, v - r, v + r};
+        index.squares[i] = square;
+
+        index.min_u = i == 0 or square.min_u < index.min_u ? square.min_u : index.min_u;
+        index.min_v = i == 0 or square.min_v < index.min_v ? square.min_v : index.min_v;
+        max_u = i == 0 or square.max_u > max_u ? square.max_u : max_u;
+        max_v = i == 0 or square.max_v > max_v ? square.max_v : max_v;
+    }
+
+    while (index.side * index.side < index.n and index.side < 1024) {
+        index.side++;
+    }
+    int64_t extent = MAX(max_u - index.min_u, max_v - index.min_v) + 1;
+    index.cell = (extent + (int64_t)index.side - 1) / (int64_t)index.side;
+
+    index.offsets = calloc(index.side * index.side + 1, sizeof(size_t));
+    for (int pass = 0; pass < 2; ++pass) {
+        for (size_t i = 0; i < index.n; ++i) {
+            square_t square = index.squares[i];
+            for (size_t bu = index_bucket(&index, square.min_u, index.min_u);
+                 bu <= index_bucket(&index, square.max_u, index.min_u); ++bu) {
+                for (size_t bv = index_bucket(&index, square.min_v, index.min_v);
+                     bv <= index_bucket(&index, square.max_v, index.min_v); ++bv) {
+                    if (pass == 0) {
+                        index.offsets[bu * index.side + bv + 1]++;
+                    } else {
+                        index.entries[index.offsets[bu * index.side + bv]++] = (uint32_t)i;
+                    }
+                }
+            }
+        }
+
+        if (pass == 0) {
+            for (size_t b = 0; b < index.side * index.side; ++b) {
+                index.offsets[b + 1] += index.offsets[b];
+            }
+            index.entries = calloc(index.offsets[index.side * index.side] + 1, sizeof(uint32_t));
         } else {
-            unmerged.left = *left;
-            unmerged.right = *right;
+            for (size_t b = index.side * index.side; b > 0; --b) {
+                index.offsets[b] = index.offsets[b - 1];
+            }
+            index.offsets[0] = 0;
+        }
+    }
+
+    return index;
+}
+
+void index_free(diamond_index_t *index) {
+    free(index->stamps);
+    free(index->entries);
+    free(index->offsets);
+    free(index->squares);
+}
+
+bool index_covers(const diamond_index_t *index, int64_t x, int64_t y) {
+    int64_t u = x + y, v = x - y;
+    size_t b = index_bucket(index, u, index->min_u) * index->side + index_bucket(index, v, index->min_v);
+    for (size_t i = index->offsets[b]; i < index->offsets[b + 1]; ++i) {
+        square_t square = index->squares[index->entries[i]];
+        if (u >= square.min_u and u <= square.max_u and v >= square.min_v and v <= square.max_v) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// number of diamonds sharing at least a position with the rectangle min..max
+size_t index_intersecting(diamond_index_t *index, const sensor_array *sensors, vec2i_t min, vec2i_t max) {
+    if (++index->stamp == 0) {
+        memset(index->stamps, 0, index->n * sizeof(uint32_t));
+        index->stamp = 1;
+    }
+
+    size_t count = 0;
+    int64_t min_u = (int64_t)min.x + min.y, max_u = (int64_t)max.x + max.y;
+    int64_t min_v = (int64_t)min.x - max.y, max_v = (int64_t)max.x - min.y;
+    for (size_t bu = index_bucket(index, min_u, index->min_u); bu <= index_bucket(index, max_u, index->min_u); ++bu) {
+        for (size_t bv = index_bucket(index, min_v, index->min_v); bv <= index_bucket(index, max_v, index->min_v);
+             ++bv) {
+            size_t b = bu * index->side + bv;
+            for (size_t i = index->offsets[b]; i < index->offsets[b + 1]; ++i) {
+                uint32_t k = index->entries[i];
+                if (index->stamps[k] == index->stamp) {
+                    continue;
+                }
+                index->stamps[k] = index->stamp;
+
+                sensor_t s = sensors->data[k];
+                int64_t x = MIN(MAX(s.p.x, min.x), max.x), y = MIN(MAX(s.p.y, min.y), max.y);
+                count += llabs(x - s.p.x) + llabs(y - s.p.y) <= radius(s);
+            }
+        }
+    }
+    return count;
+}
+
+typedef struct {
+    const sensor_array *sensors;
+    const diamond_index_t *index;
+    int64_t limit;
+    vec2i_t beacon;
+} boundary_t;
+
+bool try_point(boundary_t *boundary, int64_t x, int64_t y) {
+    if (x < 0 or y < 0 or x > boundary->limit or y > boundary->limit or index_covers(boundary->index, x, y)) {
+        return false;
+    }
+    boundary->beacon = vec2i((int)x, (int)y);
+    return true;
+}
+
+// tries every crossing of a line of constant u = x + y with a line of constant v = x - y
+bool try_crossings(boundary_t *boundary, const i64_array *us, const i64_array *vs) {
+    for (size_t i = 0; i < us->len; ++i) {
+        for (size_t j = 0; j < vs->len; ++j) {
+            int64_t u = us->data[i], v = vs->data[j];
+            if ((u + v) % 2 == 0 and try_point(boundary, (u + v) / 2, (u - v) / 2)) {
+                return true;
+            }
         }
     }
-    return unmerged;
+    return false;
+}
+
+// an uncovered cell away from the area corners has its diagonal neighbors covered, one moving along u by a diamond
+// whose u line at r + 1 or r + 2 goes through the cell, one moving along v likewise for a v line, so the cell is a
+// crossing of those lines, the ones shared by two diamonds, around one wide gaps, are crossed first, then all of them,
+// then the area edges and corners
+bool boundary_search(boundary_t *boundary) {
+    i64_array us = {0, 0, NULL}, vs = {0, 0, NULL};
+    for (size_t i = 0; i < boundary->sensors->len; ++i) {
+        sensor_t s = boundary->sensors->data[i];
+        int64_t u = (int64_t)s.p.x + s.p.y, v = (int64_t)s.p.x - s.p.y, r = radius(s);
+        for (int64_t d = r + 1; d <= r + 2; ++d) {
+            i64_array_append(&us, u - d);
+            i64_array_append(&us, u + d);
+            i64_array_append(&vs, v - d);
+            i64_array_append(&vs, v + d);
+        }
+    }
+    int64_t *scratch = calloc(us.len, sizeof(int64_t));
+    line_radix_sort(us.data, scratch, us.len);
+    line_radix_sort(vs.data, scratch, vs.len);
+    free(scratch);
+
+    i64_array shared_us = {0, 0, NULL}, shared_vs = {0, 0, NULL};
+    for (size_t i = 1; i < us.len; ++i) {
+        if (us.data[i] == us.data[i - 1] and (shared_us.len == 0 or shared_us.data[shared_us.len - 1] != us.data[i])) {
+            i64_array_append(&shared_us, us.data[i]);
+        }
+    }
+    for (size_t i = 1; i < vs.len; ++i) {
+        if (vs.data[i] == vs.data[i - 1] and (shared_vs.len == 0 or shared_vs.data[shared_vs.len - 1] != vs.data[i])) {
+            i64_array_append(&shared_vs, vs.data[i]);
+        }
+    }
+
+    const int64_t limit = boundary->limit;
+    bool found = try_crossings(boundary, &shared_us, &shared_vs) or try_crossings(boundary, &us, &vs);
+    for (size_t i = 0; i < us.len and not found; ++i) {
+        int64_t u = us.data[i];
+        found = try_point(boundary, 0, u) or try_point(boundary, limit, u - limit) or try_point(boundary, u, 0) or
+                try_point(boundary, u - limit, limit);
+    }
+    for (size_t i = 0; i < vs.len and not found; ++i) {
+        int64_t v = vs.data[i];
+        found = try_point(boundary, 0, -v) or try_point(boundary, limit, limit - v) or try_point(boundary, v, 0) or
+                try_point(boundary, v + limit, limit);
+    }
+    found = found or try_point(boundary, 0, 0) or try_point(boundary, 0, limit) or try_point(boundary, limit, 0) or
+            try_point(boundary, limit, limit);
+
+    i64_array_free(&shared_vs);
+    i64_array_free(&shared_us);
+    i64_array_free(&vs);
+    i64_array_free(&us);
+    return found;
+}
+
+// spans of every sensor in row y, kept between consecutive rows where each endpoint only moves by one
+typedef struct {
+    const sensor_array *sensors;
+    int y;
+    i64_array left, right;
+    size_t_array order;
+    interval_set_t spans;
+    vec2i_array beacons;
+} coverage_t;
+
+void coverage_seek(coverage_t *coverage, int y) {
+    const sensor_array *sensors = coverage->sensors;
+    bool next = coverage->order.len == sensors->len and y == coverage->y + 1;
+
+    for (size_t i = 0; i < sensors->len; ++i) {
+        sensor_t s = sensors->data[i];
+        if (next) {
+            int64_t grow = s.p.y > coverage->y ? 1 : -1;
+            coverage->left.data[i] -= grow;
+            coverage->right.data[i] += grow;
+        } else {
+            int64_t d = radius(s) - llabs((int64_t)s.p.y - y);
+            if (coverage->order.len < sensors->len) {
+                i64_array_append(&coverage->left, s.p.x - d);
+                i64_array_append(&coverage->right, s.p.x + d);
+                size_t_array_append(&coverage->order, i);
+            } else {
+                coverage->left.data[i] = s.p.x - d;
+                coverage->right.data[i] = s.p.x + d;
+            }
+        }
+    }
+    coverage->y = y;
+
+    // the order of the previous row is almost sorted still
+    size_t *order = coverage->order.data;
+    for (size_t i = 1; i < coverage->order.len; ++i) {
+        size_t k = order[i], j = i;
+        for (; j > 0 and coverage->left.data[order[j - 1]] > coverage->left.data[k]; --j) {
+            order[j] = order[j - 1];
+        }
+        order[j] = k;
+    }
+}
+
+// positions of the row covered by at least one sensor, minus the beacons already there
+size_t coverage_count(coverage_t *coverage) {
+    intervals_clear(&coverage->spans);
+    for (size_t i = 0; i < coverage->order.len; ++i) {
+        size_t k = coverage->order.data[i];
+        intervals_push(&coverage->spans, coverage->left.data[k], coverage->right.data[k]);
+    }
+    intervals_merge(&coverage->spans);
+    size_t count = (size_t)intervals_length(&coverage->spans);
+
+    coverage->beacons.len = 0;
+    for (size_t i = 0; i < coverage->sensors->len; ++i) {
+        vec2i_t b = coverage->sensors->data[i].b;
+        if (b.y == coverage->y and not in(&coverage->beacons, b)) {
+            vec2i_array_append(&coverage->beacons, b);
+        }
+    }
+    return count - coverage->beacons.len;
+}
+
+void coverage_free(coverage_t *coverage) {
+    vec2i_array_free(&coverage->beacons);
+    intervals_free(&coverage->spans);
+    size_t_array_free(&coverage->order);
+    i64_array_free(&coverage->right);
+    i64_array_free(&coverage->left);
+}
+
+bool parse_rows(const char *s, int_array *rows) {
+    int first, last;
+    char end;
+    if (sscanf(s, "%d..%d%c", &first, &last, &end) == 2) {
+        for (int y = first; y <= last; ++y) {
+            int_array_append(rows, y);
+        }
+        return first <= last;
+    }
+
+    for (char *next; *s != '\0'; s = *next == ',' ? next + 1 : next) {
+        long y = strtol(s, &next, 10);
+        if (next == s or (*next != ',' and *next != '\0')) {
+            return false;
+        }
+        int_array_append(rows, (int)y);
+    }
+    return rows->len > 0;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc - 2 != 1) {
+    if (argc - 1 < 2) {
         return usage(argv[0]);
     }
 
+    bool boundary_engine = false;
+    const char *rows_arg = NULL, *query_arg = NULL;
+    for (int i = 1; i < argc - 2; ++i) {
+        if (strequ(argv[i], "--engine") and i + 1 < argc - 2 and
+            (strequ(argv[i + 1], "rows") or strequ(argv[i + 1], "boundary"))) {
+            boundary_engine = strequ(argv[++i], "boundary");
+        } else if (strequ(argv[i], "--rows") and i + 1 < argc - 2) {
+            rows_arg = argv[++i];
+        } else if (strequ(argv[i], "--query") and i + 1 < argc - 2) {
+            query_arg = argv[++i];
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
     int row = 0;
-    if (sscanf(argv[1], "%d", &row) != 1) {
-        fprintf(stderr, "could not read '%s' as integer\n", argv[1]);
+    if (sscanf(argv[argc - 2], "%d", &row) != 1) {
+        fprintf(stderr, "could not read '%s' as integer\n", argv[argc - 2]);
+        return EXIT_FAILURE;
+    }
+
+    int_array rows = {0, 0, NULL};
+    if (rows_arg and not parse_rows(rows_arg, &rows)) {
+        fprintf(stderr, "could not read '%s' as a range or a list of rows\n", rows_arg);
         return EXIT_FAILURE;
     }
+    if (not rows_arg) {
+        int_array_append(&rows, row);
+    }
 
     const char *input = argv[argc - 1];
     FILE *fptr = strequ(input, "-") ? stdin : fopen(input, "r");
@@ -98,70 +457,90 @@ int main(int argc, char *argv[]) {
         sensor_array_append(&sensors, sensor);
     }
 
-    {
-        printf("--- Part One ---\n");
-        printf("Consult the report from the sensors you just deployed. In the row where y=%d, how many positions "
-               "cannot contain a beacon?\n",
-               row);
-
-        int min_x = 0, max_x = 0;
-        vec2i_array beacons_in_row = {0, 0, NULL};
-        for (size_t i = 0; i < sensors.len; ++i) {
-            sensor_t s = sensors.data[i];
-            int d = abs(s.p.x - s.b.x) + abs(s.p.y - s.b.y) - abs(s.p.y - row);
+    diamond_index_t index = index_new(&sensors);
 
-            if (d < 0) {
-                continue;
-            }
-
-            if (i == 0) {
-                min_x = s.p.x - d;
-                max_x = s.p.x + d;
-            }
-
-            min_x = s.p.x - d < min_x ? s.p.x - d : min_x;
-            max_x = s.p.x + d > max_x ? s.p.x + d : max_x;
+    if (query_arg) {
+        FILE *queries = fopen(query_arg, "r");
+        if (not queries) {
+            fprintf(stderr, "could not open %s: %s\n", query_arg, strerror(errno));
+            return EXIT_FAILURE;
+        }
 
-            if (s.b.x >= min_x and s.b.x <= max_x and s.b.y == row and not in(&beacons_in_row, s.b)) {
-                vec2i_array_append(&beacons_in_row, s.b);
+        size_t n_points = 0, n_covered = 0;
+        while (getline(&line, &len, queries) != -1) {
+            vec2i_t min = {0, 0}, max = {0, 0};
+            int n = sscanf(line, "%d,%d %d,%d", &min.x, &min.y, &max.x, &max.y);
+            if (n == 2) {
+                bool covered = index_covers(&index, min.x, min.y);
+                n_points++;
+                n_covered += covered;
+                printf("%d,%d %s\n", min.x, min.y, covered ? "covered" : "free");
+            } else if (n == 4) {
+                vec2i_t lo = vec2i(MIN(min.x, max.x), MIN(min.y, max.y));
+                vec2i_t hi = vec2i(MAX(min.x, max.x), MAX(min.y, max.y));
+                printf("%d,%d %d,%d %zu\n", min.x, min.y, max.x, max.y, index_intersecting(&index, &sensors, lo, hi));
             }
         }
+        fprintf(stderr, "%zu of %zu points are covered\n", n_covered, n_points);
+        fclose(queries);
+    }
 
-        vec2i_array_free(&beacons_in_row);
+    if (not query_arg) {
+        printf("--- Part One ---\n");
+        if (rows_arg) {
+            printf("Consult the report from the sensors you just deployed. In the rows %s, how many positions cannot "
+                   "contain a beacon?\n",
+                   rows_arg);
+        } else {
+            printf("Consult the report from the sensors you just deployed. In the row where y=%d, how many positions "
+                   "cannot contain a beacon?\n",
+                   row);
+        }
 
-        printf("%zu positions cannot contain a beacon in the row y=%d\n",
-               (size_t)abs(max_x - min_x) + 1 - beacons_in_row.len, row);
+        coverage_t coverage = {&sensors, 0, {0, 0, NULL}, {0, 0, NULL}, {0, 0, NULL}, {0, 0, NULL}, {0, 0, NULL}};
+        for (size_t i = 0; i < rows.len; ++i) {
+            coverage_seek(&coverage, rows.data[i]);
+            printf("%zu positions cannot contain a beacon in the row y=%d\n", coverage_count(&coverage), rows.data[i]);
+        }
+        coverage_free(&coverage);
     }
 
-    {
+    if (not query_arg) {
         printf("--- Part Two ---\n");
         printf("Find the only possible position for the distress beacon. What is its tuning frequency?\n");
 
-        uint64_t freq = 0;
-        for (int y = 0; y <= 2 * row; ++y) {
-            vec2i_array spans = {0, 0, NULL};
-            for (size_t i = 0; i < sensors.len; ++i) {
-                sensor_t s = sensors.data[i];
-                int d = abs(s.p.x - s.b.x) + abs(s.p.y - s.b.y) - abs(s.p.y - y);
-                if (d < 0) {
-                    continue;
-                }
+        bool found = false;
+        vec2i_t beacon = {0, 0};
+        if (boundary_engine) {
+            boundary_t boundary = {&sensors, &index, 2 * (int64_t)row, {0, 0}};
+            found = boundary_search(&boundary);
+            beacon = boundary.beacon;
+        } else {
+            long n_processors = sysconf(_SC_NPROCESSORS_ONLN);
+            size_t n_threads = n_processors > 0 ? (size_t)n_processors : 1;
 
-                vec2i_t span = {MAX(0, s.p.x - d), MIN(2 * row, s.p.x + d)};
-                vec2i_array_append(&spans, span);
+            int next = 0;
+            pthread_t *threads = calloc(n_threads, sizeof(pthread_t));
+            scanner_t *scanners = calloc(n_threads, sizeof(scanner_t));
+            for (size_t i = 0; i < n_threads; ++i) {
+                scanner_t scanner = {&sensors, 2 * row, &next, &found, &beacon};
+                scanners[i] = scanner;
+                pthread_create(&threads[i], NULL, scan_rows, &scanners[i]);
             }
-            sort_spans(&spans);
-            pair_t unmerged = merge_spans(&spans);
-            vec2i_array_free(&spans);
-            if (not vec2i_equ(unmerged.left, vec2i(0, 0)) and not vec2i_equ(unmerged.right, vec2i(0, 0))) {
-                freq = (uint64_t)(unmerged.left.y + unmerged.right.x) * (uint64_t)row + (uint64_t)y;
-                break;
+            for (size_t i = 0; i < n_threads; ++i) {
+                pthread_join(threads[i], NULL);
             }
+            free(scanners);
+            free(threads);
         }
 
+        uint64_t freq = found ? (uint64_t)beacon.x * (uint64_t)(2 * row) + (uint64_t)beacon.y : 0;
+
         printf("Its tuning frequency is %lu.\n", freq);
     }
 
+    index_free(&index);
+    int_array_free(&rows);
     sensor_array_free(&sensors);
 
     free(line);
@@ -1,13 +1,203 @@
 #include <errno.h>
 #include <iso646.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-#include "array.h"
 #include "helpers.h"
+#include "mapped.h"
+
+#define AUTOMATON_STATES 40
+
+// Aho-Corasick automaton over the spelled digits as a full transition table, digit[state] is the value of the word
+// ending in state, 0 when none does
+typedef struct {
+    uint8_t next[AUTOMATON_STATES][256];
+    uint8_t digit[AUTOMATON_STATES];
+} automaton_t;
+
+// the first digit of a line is found scanning forward, the last one scanning backward with the reversed words
+typedef struct {
+    automaton_t forward, backward;
+} matcher_t;
+
+void automaton_build(automaton_t *automaton, bool reversed) {
+    const char *words[] = {"one", "two", "three", "four", "five", "six", "seven", "eight", "nine"};
+
+    memset(automaton, 0, sizeof(*automaton));
+    size_t n_states = 1;
+    for (size_t i = 0; i < 9; ++i) {
+        size_t len = strlen(words[i]);
+        uint8_t state = 0;
+        for (size_t k = 0; k < len; ++k) {
+            uint8_t c = (uint8_t)words[i][reversed ? len - 1 - k : k];
+            if (automaton->next[state][c] == 0) {
+                automaton->next[state][c] = (uint8_t)n_states++;
+            }
+            state = automaton->next[state][c];
+        }
+        automaton->digit[state] = (uint8_t)(i + 1);
+    }
+
+    // breadth first over the trie, missing transitions are those of the failure state, which is shallower
+    uint8_t fail[AUTOMATON_STATES] = {0}, queue[AUTOMATON_STATES];
+    size_t head = 0, tail = 0;
+    for (size_t c = 0; c < 256; ++c) {
+        if (automaton->next[0][c] != 0) {
+            queue[tail++] = automaton->next[0][c];
+        }
+    }
+    while (head < tail) {
+        uint8_t state = queue[head++];
+        if (automaton->digit[state] == 0) {
+            automaton->digit[state] = automaton->digit[fail[state]];
+        }
+        for (size_t c = 0; c < 256; ++c) {
+            uint8_t child = automaton->next[state][c];
+            if (child != 0) {
+                fail[child] = automaton->next[fail[state]][c];
+                queue[tail++] = child;
+            } else {
+                automaton->next[state][c] = automaton->next[fail[state]][c];
+            }
+        }
+    }
+}
+
+typedef struct {
+    uint64_t digits, spelled;
+} sums_t;
+
+static inline unsigned digit(uint8_t c) { return (unsigned)(c - '0'); }
+
+typedef uint8_t u8x16 __attribute__((vector_size(16)));
+
+// lanes of the 16 bytes at p holding a digit, one byte of 0xff per digit
+static inline void digit_lanes(const uint8_t *p, uint64_t halves[2]) {
+    const u8x16 zeros = {'0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0'};
+    const u8x16 tens = {10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10};
+
+    u8x16 bytes;
+    memcpy(&bytes, p, sizeof(bytes));
+    u8x16 digits = (u8x16)(bytes - zeros < tens);
+    memcpy(halves, &digits, 2 * sizeof(uint64_t));
+}
+
+// offset of the first digit of begin..end, end - begin when there is none
+static inline size_t first_digit(const uint8_t *begin, const uint8_t *end) {
+    const uint8_t *p = begin;
+    for (uint64_t halves[2]; p + 16 <= end; p += 16) {
+        digit_lanes(p, halves);
+        if (halves[0] != 0) {
+            return (size_t)(p - begin) + (size_t)__builtin_ctzll(halves[0]) / 8;
+        }
+        if (halves[1] != 0) {
+            return (size_t)(p - begin) + 8 + (size_t)__builtin_ctzll(halves[1]) / 8;
+        }
+    }
+    for (; p < end and digit(*p) >= 10; ++p) {
+    }
+    return (size_t)(p - begin);
+}
+
+// offset one past the last digit of begin..end, 0 when there is none
+static inline size_t last_digit(const uint8_t *begin, const uint8_t *end) {
+    const uint8_t *p = end;
+    for (uint64_t halves[2]; p - begin >= 16; p -= 16) {
+        digit_lanes(p - 16, halves);
+        if (halves[1] != 0) {
+            return (size_t)(p - begin) - (size_t)__builtin_clzll(halves[1]) / 8;
+        }
+        if (halves[0] != 0) {
+            return (size_t)(p - begin) - 8 - (size_t)__builtin_clzll(halves[0]) / 8;
+        }
+    }
+    for (; p > begin and digit(p[-1]) >= 10; --p) {
+    }
+    return (size_t)(p - begin);
+}
+
+// adds the calibration values of the line begin..end, without its newline, to the sums of both parts, the automata
+// only run over the letters before the first and after the last digit
+static inline void calibrate_line(const matcher_t *matcher, const uint8_t *begin, const uint8_t *end, sums_t *sums) {
+    const uint8_t *first = begin + first_digit(begin, end), *last = begin + last_digit(begin, end);
+    unsigned first_value = first < end ? digit(*first) : 0, last_value = last > begin ? digit(last[-1]) : 0;
+
+    unsigned first_spelled = first_value;
+    uint8_t state = 0;
+    for (const uint8_t *c = begin; c < first; ++c) {
+        state = matcher->forward.next[state][*c];
+        if (matcher->forward.digit[state] != 0) {
+            first_spelled = matcher->forward.digit[state];
+            break;
+        }
+    }
+
+    unsigned last_spelled = last_value;
+    state = 0;
+    for (const uint8_t *c = end; c-- > last;) {
+        state = matcher->backward.next[state][*c];
+        if (matcher->backward.digit[state] != 0) {
+            last_spelled = matcher->backward.digit[state];
+            break;
+        }
+    }
 
-ARRAY(int, int_array)
+    sums->digits += 10 * first_value + last_value;
+    sums->spelled += 10 * first_spelled + last_spelled;
+}
+
+// a newline aligned part of the input, calibrated by one thread into its own sums
+typedef struct {
+    const matcher_t *matcher;
+    const char *data;
+    size_t len;
+    sums_t sums;
+} chunk_t;
+
+void *calibrate(void *arg) {
+    chunk_t *chunk = arg;
+    const uint8_t *p = (const uint8_t *)chunk->data, *end = p + chunk->len;
+    while (p < end) {
+        const uint8_t *newline = memchr(p, '\n', (size_t)(end - p));
+        newline = newline ? newline : end;
+        calibrate_line(chunk->matcher, p, newline, &chunk->sums);
+        p = newline + 1;
+    }
+    return NULL;
+}
+
+sums_t calibrate_parallel(const matcher_t *matcher, const char *data, size_t len, size_t n_threads) {
+    pthread_t *threads = calloc(n_threads, sizeof(pthread_t));
+    chunk_t *chunks = calloc(n_threads, sizeof(chunk_t));
+
+    size_t begin = 0;
+    for (size_t t = 0; t < n_threads; ++t) {
+        size_t end = t + 1 < n_threads ? len / n_threads * (t + 1) : len;
+        end = end > begin ? end : begin;
+        const char *newline = end < len ? memchr(data + end, '\n', len - end) : NULL;
+        end = newline ? (size_t)(newline - data) + 1 : len;
+
+        chunk_t chunk = {matcher, data + begin, end - begin, {0, 0}};
+        chunks[t] = chunk;
+        pthread_create(&threads[t], NULL, calibrate, &chunks[t]);
+        begin = end;
+    }
+
+    sums_t sums = {0, 0};
+    for (size_t t = 0; t < n_threads; ++t) {
+        pthread_join(threads[t], NULL);
+        sums.digits += chunks[t].sums.digits;
+        sums.spelled += chunks[t].sums.spelled;
+    }
+
+    free(chunks);
+    free(threads);
+    return sums;
+}
 
 int usage(const char *name) {
     printf("usage: %s input\n", name);
@@ -27,86 +217,23 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
-    char *line = NULL;
-    size_t len = 0;
-
-    int_array calibrations = {1, 0, calloc(1, sizeof(int))}, calibrations_all_digits = {1, 0, calloc(1, sizeof(int))};
-
-    char *digits_strings[] = {"one", "two", "three", "four", "five", "six", "seven", "eight", "nine"};
-    while (getline(&line, &len, fptr) != -1) {
-        char digits[3] = "";
-        for (char *c = line; *c != '\0'; ++c) {
-            if (*c >= '0' and *c <= '9') {
-                if (digits[0] == '\0') {
-                    digits[0] = *c;
-                } else {
-                    digits[1] = *c;
-                }
-            }
-        }
-
-        if (digits[1] == '\0') {
-            digits[1] = digits[0];
-        }
-
-        errno = 0;
-        int_array_append(&calibrations, (int)strtol(digits, NULL, 10));
-        if (errno != 0) {
-            fprintf(stderr, "could not convert string '%s' to long: %s\n", digits, strerror(errno));
-            return EXIT_FAILURE;
-        }
-
-        char *line_interpreted = calloc(len, sizeof(char)), *cp = line_interpreted;
-        for (char *c = line; *c != '\0'; ++c) {
-            bool matched = false;
-            for (size_t i = 0; i < 9; ++i) {
-                char *p = strstr(c, digits_strings[i]);
-                if (p == c) {
-                    *cp = '1' + (char)i;
-                    cp++;
-                    matched = true;
-                }
-            }
-
-            if (not matched) {
-                *cp = *c;
-                cp++;
-            }
-        }
-
-        for (size_t i = 0; i < 3; ++i) {
-            digits[i] = '\0';
-        }
-        for (char *c = line_interpreted; *c != '\0'; ++c) {
-            if (*c >= '0' and *c <= '9') {
-                if (digits[0] == '\0') {
-                    digits[0] = *c;
-                } else {
-                    digits[1] = *c;
-                }
-            }
-        }
+    mapped_t mapped = mapped_open(fptr);
+    if (not mapped.data) {
+        fprintf(stderr, "could not read %s: %s\n", input, strerror(errno));
+        return EXIT_FAILURE;
+    }
 
-        if (digits[1] == '\0') {
-            digits[1] = digits[0];
-        }
+    matcher_t *matcher = malloc(sizeof(matcher_t));
+    automaton_build(&matcher->forward, false);
+    automaton_build(&matcher->backward, true);
 
-        errno = 0;
-        int_array_append(&calibrations_all_digits, (int)strtol(digits, NULL, 10));
-        if (errno != 0) {
-            fprintf(stderr, "could not convert string '%s' to long: %s\n", digits, strerror(errno));
-            return EXIT_FAILURE;
-        }
-    }
+    long n_processors = sysconf(_SC_NPROCESSORS_ONLN);
+    sums_t sums = calibrate_parallel(matcher, mapped.data, mapped.len, n_processors > 0 ? (size_t)n_processors : 1);
 
     printf("--- Part One ---\n");
     printf("Consider your entire calibration document. What is the sum of all of the calibration values?\n");
 
-    long sum = 0;
-    for (size_t i = 0; i < calibrations.len; ++i) {
-        sum += calibrations.data[i];
-    }
-    printf("The sum of all of the calibration values is %ld\n", sum);
+    printf("The sum of all of the calibration values is %lu\n", sums.digits);
 
     printf("--- Part Two ---\n");
     printf("Your calculation isn't quite right. It looks like some of the digits are actually spelled out with "
@@ -114,13 +241,11 @@ int main(int argc, char *argv[]) {
            "with this new information, you now need to find the real first and last digit on each line.\n");
     printf("What is the sum of all of the calibration values?\n");
 
-    sum = 0;
-    for (size_t i = 0; i < calibrations_all_digits.len; ++i) {
-        sum += calibrations_all_digits.data[i];
-    }
-    printf("The sum of all of the calibration values is %ld\n", sum);
+    printf("The sum of all of the calibration values is %lu\n", sums.spelled);
+
+    free(matcher);
+    mapped_close(&mapped);
 
-    free(line);
     if (fptr != stdin) {
         fclose(fptr);
     }
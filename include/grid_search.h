@@ -0,0 +1,304 @@
+#pragma once
+
+#include <iso646.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GRID_NONE UINT32_MAX
+
+typedef struct {
+    size_t width, height;
+    const uint8_t *cells;
+} grid_t;
+
+// cost of stepping from one cell to a neighbor, GRID_NONE when the step is not allowed
+typedef uint32_t (*grid_cost_f)(const grid_t *grid, size_t from, size_t to, void *user);
+typedef uint32_t (*grid_heuristic_f)(const grid_t *grid, size_t from, size_t target, void *user);
+
+typedef struct {
+    uint32_t cost, index;
+} grid_heap_entry_t;
+
+// what a workspace is sized for: a plain BFS only needs GRID_QUEUE, the parent array for grid_path is GRID_PATHS
+enum { GRID_QUEUE = 1, GRID_DEQUE = 2, GRID_HEAP = 4, GRID_PATHS = 8 };
+
+typedef struct {
+    size_t cap;
+    unsigned needs;
+    uint32_t *dist, *parent, *queue;
+    uint64_t *visited;
+    grid_heap_entry_t *heap;
+    size_t heap_len;
+} grid_workspace_t;
+
+void grid_workspace_free(grid_workspace_t *ws) {
+    free(ws->dist);
+    free(ws->parent);
+    free(ws->queue);
+    free(ws->visited);
+    free(ws->heap);
+}
+
+// a cell is pushed at most once per incoming edge, 4 of them, and once as a source, in the deque and the heap, on a
+// failed allocation the workspace is left as it was
+bool grid_workspace_reserve(grid_workspace_t *ws, size_t n, unsigned needs) {
+    if (n <= ws->cap and (needs & ~ws->needs) == 0) {
+        return true;
+    }
+    needs |= ws->needs;
+    n = n > ws->cap ? n : ws->cap;
+
+    grid_workspace_t grown = {n, needs, NULL, NULL, NULL, NULL, NULL, 0};
+    grown.dist = calloc(n, sizeof(uint32_t));
+    grown.visited = calloc((n + 63) / 64, sizeof(uint64_t));
+    if (needs & GRID_PATHS) {
+        grown.parent = calloc(n, sizeof(uint32_t));
+    }
+    if (needs & (GRID_QUEUE | GRID_DEQUE)) {
+        grown.queue = calloc(needs & GRID_DEQUE ? 5 * n : n, sizeof(uint32_t));
+    }
+    if (needs & GRID_HEAP) {
+        grown.heap = calloc(5 * n, sizeof(grid_heap_entry_t));
+    }
+    if (not grown.dist or not grown.visited or (needs & GRID_PATHS and not grown.parent) or
+        (needs & (GRID_QUEUE | GRID_DEQUE) and not grown.queue) or (needs & GRID_HEAP and not grown.heap)) {
+        grid_workspace_free(&grown);
+        return false;
+    }
+
+    grid_workspace_free(ws);
+    *ws = grown;
+    return true;
+}
+
+static inline bool grid_visited(const grid_workspace_t *ws, size_t i) { return ws->visited[i / 64] >> (i % 64) & 1; }
+static inline void grid_visit(grid_workspace_t *ws, size_t i) { ws->visited[i / 64] |= UINT64_C(1) << (i % 64); }
+
+static inline size_t grid_neighbors(const grid_t *grid, size_t i, size_t neighbors[4]) {
+    size_t n = 0, x = i % grid->width;
+    if (i >= grid->width) {
+        neighbors[n++] = i - grid->width;
+    }
+    if (x + 1 < grid->width) {
+        neighbors[n++] = i + 1;
+    }
+    if (i + grid->width < grid->width * grid->height) {
+        neighbors[n++] = i + grid->width;
+    }
+    if (x > 0) {
+        neighbors[n++] = i - 1;
+    }
+    return n;
+}
+
+static inline void grid_set_parent(grid_workspace_t *ws, size_t v, uint32_t u) {
+    if (ws->parent) {
+        ws->parent[v] = u;
+    }
+}
+
+static void grid_reset(const grid_t *grid, grid_workspace_t *ws) {
+    size_t n = grid->width * grid->height;
+    memset(ws->dist, 0xff, n * sizeof(uint32_t));
+    if (ws->parent) {
+        memset(ws->parent, 0xff, n * sizeof(uint32_t));
+    }
+    memset(ws->visited, 0, (n + 63) / 64 * sizeof(uint64_t));
+    ws->heap_len = 0;
+}
+
+// breadth first search from every source at once, stops early once target is reached unless target is GRID_NONE,
+// allowed(grid, from, to, user) is expanded inline so a step rule written as a macro or static inline function costs no
+// call per edge, the workspace must have GRID_QUEUE
+#define GRID_BFS(name, allowed)                                                                                        \
+    void name(const grid_t *grid, grid_workspace_t *ws, const uint32_t *sources, size_t n_sources, uint32_t target,    \
+              void *user) {                                                                                            \
+        (void)user;                                                                                                    \
+        grid_reset(grid, ws);                                                                                          \
+                                                                                                                       \
+        size_t head = 0, tail = 0;                                                                                     \
+        for (size_t i = 0; i < n_sources; ++i) {                                                                       \
+            if (!grid_visited(ws, sources[i])) {                                                                       \
+                grid_visit(ws, sources[i]);                                                                            \
+                ws->dist[sources[i]] = 0;                                                                              \
+                ws->queue[tail++] = sources[i];                                                                        \
+            }                                                                                                          \
+        }                                                                                                              \
+                                                                                                                       \
+        while (head < tail) {                                                                                          \
+            uint32_t u = ws->queue[head++];                                                                            \
+            if (u == target) {                                                                                         \
+                return;                                                                                                \
+            }                                                                                                          \
+                                                                                                                       \
+            size_t neighbors[4], n = grid_neighbors(grid, u, neighbors);                                               \
+            for (size_t i = 0; i < n; ++i) {                                                                           \
+                size_t v = neighbors[i];                                                                               \
+                if (grid_visited(ws, v) || !allowed(grid, u, v, user)) {                                               \
+                    continue;                                                                                          \
+                }                                                                                                      \
+                grid_visit(ws, v);                                                                                     \
+                ws->dist[v] = ws->dist[u] + 1;                                                                         \
+                grid_set_parent(ws, v, u);                                                                             \
+                ws->queue[tail++] = (uint32_t)v;                                                                       \
+            }                                                                                                          \
+        }                                                                                                              \
+    }
+
+typedef struct {
+    grid_cost_f cost;
+    void *user;
+} grid_callback_t;
+
+#define GRID_CALLBACK_ALLOWED(grid, from, to, callback)                                                                \
+    (((grid_callback_t *)(callback))->cost(grid, from, to, ((grid_callback_t *)(callback))->user) != GRID_NONE)
+
+GRID_BFS(grid_bfs_callback, GRID_CALLBACK_ALLOWED)
+
+// the same search calling cost for every edge, for step rules only known at run time
+void grid_bfs(const grid_t *grid, grid_workspace_t *ws, const uint32_t *sources, size_t n_sources, uint32_t target,
+              grid_cost_f cost, void *user) {
+    grid_callback_t callback = {cost, user};
+    grid_bfs_callback(grid, ws, sources, n_sources, target, &callback);
+}
+
+// breadth first search over edges costing 0 or 1, zero cost neighbors are pushed to the front of a deque, the
+// workspace must have GRID_DEQUE
+void grid_bfs01(const grid_t *grid, grid_workspace_t *ws, const uint32_t *sources, size_t n_sources, uint32_t target,
+                grid_cost_f cost, void *user) {
+    grid_reset(grid, ws);
+
+    const size_t cap = 5 * ws->cap;
+    size_t head = 0, len = 0;
+    for (size_t i = 0; i < n_sources; ++i) {
+        ws->dist[sources[i]] = 0;
+        ws->queue[(head + len++) % cap] = sources[i];
+    }
+
+    while (len > 0) {
+        uint32_t u = ws->queue[head];
+        head = (head + 1) % cap;
+        len--;
+        if (grid_visited(ws, u)) {
+            continue;
+        }
+        grid_visit(ws, u);
+        if (u == target) {
+            return;
+        }
+
+        size_t neighbors[4], n = grid_neighbors(grid, u, neighbors);
+        for (size_t i = 0; i < n; ++i) {
+            size_t v = neighbors[i];
+            uint32_t w = cost(grid, u, v, user);
+            if (w == GRID_NONE or grid_visited(ws, v) or ws->dist[u] + w >= ws->dist[v]) {
+                continue;
+            }
+            ws->dist[v] = ws->dist[u] + w;
+            grid_set_parent(ws, v, u);
+            if (w == 0) {
+                head = (head + cap - 1) % cap;
+                ws->queue[head] = (uint32_t)v;
+            } else {
+                ws->queue[(head + len) % cap] = (uint32_t)v;
+            }
+            len++;
+        }
+    }
+}
+
+static inline bool grid_heap_less(grid_heap_entry_t a, grid_heap_entry_t b) { return a.cost < b.cost; }
+
+static void grid_heap_push(grid_workspace_t *ws, uint32_t cost, uint32_t index) {
+    size_t i = ws->heap_len++;
+    grid_heap_entry_t entry = {cost, index};
+    while (i > 0 and grid_heap_less(entry, ws->heap[(i - 1) / 2])) {
+        ws->heap[i] = ws->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    ws->heap[i] = entry;
+}
+
+static grid_heap_entry_t grid_heap_pop(grid_workspace_t *ws) {
+    grid_heap_entry_t top = ws->heap[0], last = ws->heap[--ws->heap_len];
+    size_t i = 0;
+    for (size_t child; (child = 2 * i + 1) < ws->heap_len; i = child) {
+        if (child + 1 < ws->heap_len and grid_heap_less(ws->heap[child + 1], ws->heap[child])) {
+            child++;
+        }
+        if (not grid_heap_less(ws->heap[child], last)) {
+            break;
+        }
+        ws->heap[i] = ws->heap[child];
+    }
+    ws->heap[i] = last;
+    return top;
+}
+
+// A* on a binary heap, a NULL heuristic turns it into Dijkstra, the workspace must have GRID_HEAP
+// a cell is closed the first time it is popped, which only gives shortest paths with a consistent heuristic, one never
+// dropping by more than the cost of a step: heuristic(from) <= cost(from, to) + heuristic(to)
+void grid_astar(const grid_t *grid, grid_workspace_t *ws, const uint32_t *sources, size_t n_sources, uint32_t target,
+                grid_cost_f cost, grid_heuristic_f heuristic, void *user) {
+    grid_reset(grid, ws);
+
+    for (size_t i = 0; i < n_sources; ++i) {
+        ws->dist[sources[i]] = 0;
+        grid_heap_push(ws, heuristic ? heuristic(grid, sources[i], target, user) : 0, sources[i]);
+    }
+
+    while (ws->heap_len > 0) {
+        uint32_t u = grid_heap_pop(ws).index;
+        if (grid_visited(ws, u)) {
+            continue;
+        }
+        grid_visit(ws, u);
+        if (u == target) {
+            return;
+        }
+
+        size_t neighbors[4], n = grid_neighbors(grid, u, neighbors);
+        for (size_t i = 0; i < n; ++i) {
+            size_t v = neighbors[i];
+            uint32_t w = cost(grid, u, v, user);
+            if (w == GRID_NONE or grid_visited(ws, v) or ws->dist[u] + w >= ws->dist[v]) {
+                continue;
+            }
+            ws->dist[v] = ws->dist[u] + w;
+            grid_set_parent(ws, v, u);
+            grid_heap_push(ws, ws->dist[v] + (heuristic ? heuristic(grid, v, target, user) : 0), (uint32_t)v);
+        }
+    }
+}
+
+void grid_dijkstra(const grid_t *grid, grid_workspace_t *ws, const uint32_t *sources, size_t n_sources,
+                   uint32_t target, grid_cost_f cost, void *user) {
+    grid_astar(grid, ws, sources, n_sources, target, cost, NULL, user);
+}
+
+uint32_t grid_manhattan(const grid_t *grid, size_t from, size_t target, void *user) {
+    (void)user;
+    size_t fx = from % grid->width, fy = from / grid->width, tx = target % grid->width, ty = target / grid->width;
+    return (uint32_t)((fx > tx ? fx - tx : tx - fx) + (fy > ty ? fy - ty : ty - fy));
+}
+
+// writes the path ending at target into path, from the source to target, and returns its length, 0 without GRID_PATHS
+size_t grid_path(const grid_workspace_t *ws, uint32_t target, uint32_t *path, size_t cap) {
+    if (not ws->parent) {
+        return 0;
+    }
+    size_t len = 0;
+    for (uint32_t i = target; i != GRID_NONE; i = ws->parent[i]) {
+        len++;
+    }
+    if (ws->dist[target] == GRID_NONE or len > cap) {
+        return 0;
+    }
+    size_t k = len;
+    for (uint32_t i = target; i != GRID_NONE; i = ws->parent[i]) {
+        path[--k] = i;
+    }
+    return len;
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <iso646.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sort.h"
+
+// closed range of integers lo..hi
+typedef struct {
+    int64_t lo, hi;
+} interval_t;
+
+extern inline interval_t interval(int64_t lo, int64_t hi) {
+    interval_t i = {lo, hi};
+    return i;
+}
+
+extern inline bool interval_contains(interval_t a, interval_t b) { return b.lo >= a.lo and b.hi <= a.hi; }
+extern inline bool interval_overlaps(interval_t a, interval_t b) { return a.lo <= b.hi and b.lo <= a.hi; }
+
+// intervals kept sorted, disjoint and non adjacent in one flat array, clearing keeps the storage for the next use
+// intervals_push appends without merging, intervals_merge must then run before any query
+typedef struct {
+    size_t cap, len;
+    interval_t *data;
+} interval_set_t;
+
+extern inline void intervals_clear(interval_set_t *set) { set->len = 0; }
+
+extern inline void intervals_free(interval_set_t *set) { free(set->data); }
+
+static inline bool intervals_reserve(interval_set_t *set, size_t len) {
+    if (len <= set->cap) {
+        return true;
+    }
+    size_t cap = set->cap ? set->cap : 16;
+    while (cap < len) {
+        cap *= 2;
+    }
+    interval_t *data = realloc(set->data, cap * sizeof(interval_t));
+    if (not data) {
+        return false;
+    }
+    set->data = data;
+    set->cap = cap;
+    return true;
+}
+
+bool intervals_push(interval_set_t *set, int64_t lo, int64_t hi) {
+    if (lo > hi) {
+        return true;
+    }
+    if (not intervals_reserve(set, set->len + 1)) {
+        return false;
+    }
+    set->data[set->len++] = interval(lo, hi);
+    return true;
+}
+
+#define INTERVAL_LESS(a, b) ((a).lo < (b).lo)
+
+SORT(interval_t, interval, INTERVAL_LESS)
+
+// sorts the pushed intervals unless they were pushed in order already, then coalesces them
+void intervals_merge(interval_set_t *set) {
+    size_t sorted = 1;
+    while (sorted < set->len and set->data[sorted - 1].lo <= set->data[sorted].lo) {
+        sorted++;
+    }
+    if (sorted < set->len) {
+        interval_sort(set->data, set->len);
+    }
+
+    size_t len = 0;
+    for (size_t i = 0; i < set->len; ++i) {
+        if (len > 0 and (set->data[len - 1].hi == INT64_MAX or set->data[i].lo <= set->data[len - 1].hi + 1)) {
+            if (set->data[i].hi > set->data[len - 1].hi) {
+                set->data[len - 1].hi = set->data[i].hi;
+            }
+        } else {
+            set->data[len++] = set->data[i];
+        }
+    }
+    set->len = len;
+}
+
+// index of the first interval whose end is not before x
+static inline size_t intervals_lower_bound(const interval_set_t *set, int64_t x) {
+    size_t lo = 0, hi = set->len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (set->data[mid].hi < x) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// adds lo..hi to a merged set, coalescing it with the intervals it touches
+bool intervals_insert(interval_set_t *set, int64_t lo, int64_t hi) {
+    if (lo > hi) {
+        return true;
+    }
+
+    size_t first = intervals_lower_bound(set, lo == INT64_MIN ? lo : lo - 1), last = first;
+    while (last < set->len and (hi == INT64_MAX or set->data[last].lo <= hi + 1)) {
+        lo = set->data[last].lo < lo ? set->data[last].lo : lo;
+        hi = set->data[last].hi > hi ? set->data[last].hi : hi;
+        last++;
+    }
+
+    if (first == last) {
+        if (not intervals_reserve(set, set->len + 1)) {
+            return false;
+        }
+        memmove(set->data + first + 1, set->data + first, (set->len - first) * sizeof(interval_t));
+        set->len++;
+    } else {
+        memmove(set->data + first + 1, set->data + last, (set->len - last) * sizeof(interval_t));
+        set->len -= last - first - 1;
+    }
+    set->data[first] = interval(lo, hi);
+    return true;
+}
+
+uint64_t intervals_length(const interval_set_t *set) {
+    uint64_t length = 0;
+    for (size_t i = 0; i < set->len; ++i) {
+        length += (uint64_t)(set->data[i].hi - set->data[i].lo) + 1;
+    }
+    return length;
+}
+
+// first integer of lo..hi outside every interval, false when lo..hi is fully covered
+bool intervals_first_gap(const interval_set_t *set, int64_t lo, int64_t hi, int64_t *gap) {
+    for (size_t i = intervals_lower_bound(set, lo); i < set->len and set->data[i].lo <= lo; ++i) {
+        if (set->data[i].hi >= hi) {
+            return false;
+        }
+        lo = set->data[i].hi + 1;
+    }
+    if (lo > hi) {
+        return false;
+    }
+    *gap = lo;
+    return true;
+}
+
+bool intervals_contains(const interval_set_t *set, int64_t x) {
+    size_t i = intervals_lower_bound(set, x);
+    return i < set->len and set->data[i].lo <= x;
+}
+
+bool intervals_overlaps(const interval_set_t *set, int64_t lo, int64_t hi) {
+    size_t i = intervals_lower_bound(set, lo);
+    return lo <= hi and i < set->len and set->data[i].lo <= hi;
+}
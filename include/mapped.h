@@ -0,0 +1,57 @@
+#pragma once
+
+#include <iso646.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// the whole input in memory, mapped when possible, data always ends with a newline
+typedef struct {
+    char *data;
+    size_t len;
+    bool mapped;
+} mapped_t;
+
+mapped_t mapped_open(FILE *fptr) {
+    mapped_t m = {NULL, 0, false};
+
+    struct stat st;
+    if (fstat(fileno(fptr), &st) == 0 and S_ISREG(st.st_mode) and st.st_size > 0) {
+        void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(fptr), 0);
+        if (data != MAP_FAILED and ((char *)data)[st.st_size - 1] == '\n') {
+            m.data = data;
+            m.len = (size_t)st.st_size;
+            m.mapped = true;
+            return m;
+        }
+        if (data != MAP_FAILED) {
+            munmap(data, (size_t)st.st_size);
+        }
+    }
+
+    size_t cap = 1 << 16;
+    m.data = malloc(cap);
+    size_t n;
+    while (m.data and (n = fread(m.data + m.len, 1, cap - m.len, fptr)) > 0) {
+        m.len += n;
+        if (m.len == cap) {
+            cap *= 2;
+            m.data = realloc(m.data, cap);
+        }
+    }
+    if (m.data and (m.len == 0 or m.data[m.len - 1] != '\n')) {
+        m.data[m.len++] = '\n';
+    }
+    return m;
+}
+
+void mapped_close(mapped_t *m) {
+    if (m->mapped) {
+        munmap(m->data, m->len);
+    } else {
+        free(m->data);
+    }
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SORT_INSERTION_CUTOFF 16
+
+// less(a, b) is expanded inline in every generated function, name##_sort is an introsort (quicksort on a median of
+// three falling back to heapsort when recursing too deep, small ranges finish with an insertion sort) and
+// name##_stable_sort a merge sort using tmp, a scratch buffer of n elements
+#define SORT(type, name, less)                                                                                         \
+    static inline void name##_insertion_sort(type *data, size_t n) {                                                   \
+        for (size_t i = 1; i < n; ++i) {                                                                               \
+            type value = data[i];                                                                                      \
+            size_t j = i;                                                                                              \
+            for (; j > 0 && less(value, data[j - 1]); --j) {                                                           \
+                data[j] = data[j - 1];                                                                                 \
+            }                                                                                                          \
+            data[j] = value;                                                                                           \
+        }                                                                                                              \
+    }                                                                                                                  \
+    static inline void name##_swap(type *data, size_t i, size_t j) {                                                   \
+        type value = data[i];                                                                                          \
+        data[i] = data[j];                                                                                             \
+        data[j] = value;                                                                                               \
+    }                                                                                                                  \
+    static inline void name##_sift_down(type *data, size_t i, size_t n) {                                              \
+        for (size_t child; (child = 2 * i + 1) < n; i = child) {                                                       \
+            if (child + 1 < n && less(data[child], data[child + 1])) {                                                 \
+                child++;                                                                                               \
+            }                                                                                                          \
+            if (!less(data[i], data[child])) {                                                                         \
+                break;                                                                                                 \
+            }                                                                                                          \
+            name##_swap(data, i, child);                                                                               \
+        }                                                                                                              \
+    }                                                                                                                  \
+    static inline void name##_heap_sort(type *data, size_t n) {                                                        \
+        for (size_t i = n / 2; i-- > 0;) {                                                                             \
+            name##_sift_down(data, i, n);                                                                              \
+        }                                                                                                              \
+        for (size_t end = n; end-- > 1;) {                                                                             \
+            name##_swap(data, 0, end);                                                                                 \
+            name##_sift_down(data, 0, end);                                                                            \
+        }                                                                                                              \
+    }                                                                                                                  \
+    static inline size_t name##_partition(type *data, size_t n) {                                                      \
+        size_t mid = (n - 1) / 2;                                                                                      \
+        if (less(data[mid], data[0])) {                                                                                \
+            name##_swap(data, 0, mid);                                                                                 \
+        }                                                                                                              \
+        if (less(data[n - 1], data[mid])) {                                                                            \
+            name##_swap(data, mid, n - 1);                                                                             \
+            if (less(data[mid], data[0])) {                                                                            \
+                name##_swap(data, 0, mid);                                                                             \
+            }                                                                                                          \
+        }                                                                                                              \
+        type pivot = data[mid];                                                                                        \
+        size_t i = 0, j = n - 1;                                                                                       \
+        for (;;) {                                                                                                     \
+            while (less(data[i], pivot)) {                                                                             \
+                i++;                                                                                                   \
+            }                                                                                                          \
+            while (less(pivot, data[j])) {                                                                             \
+                j--;                                                                                                   \
+            }                                                                                                          \
+            if (i >= j) {                                                                                              \
+                return j + 1;                                                                                          \
+            }                                                                                                          \
+            name##_swap(data, i++, j--);                                                                               \
+        }                                                                                                              \
+    }                                                                                                                  \
+    void name##_sort(type *data, size_t n) {                                                                           \
+        size_t depth = 0;                                                                                              \
+        for (size_t m = n; m > 1; m /= 2) {                                                                            \
+            depth += 2;                                                                                                \
+        }                                                                                                              \
+        while (n > SORT_INSERTION_CUTOFF) {                                                                            \
+            if (depth-- == 0) {                                                                                        \
+                name##_heap_sort(data, n);                                                                             \
+                return;                                                                                                \
+            }                                                                                                          \
+            size_t split = name##_partition(data, n);                                                                  \
+            if (split < n - split) {                                                                                   \
+                name##_sort(data, split);                                                                              \
+                data += split;                                                                                         \
+                n -= split;                                                                                            \
+            } else {                                                                                                   \
+                name##_sort(data + split, n - split);                                                                  \
+                n = split;                                                                                             \
+            }                                                                                                          \
+        }                                                                                                              \
+        name##_insertion_sort(data, n);                                                                                \
+    }                                                                                                                  \
+    void name##_merge(const type *left, size_t n_left, const type *right, size_t n_right, type *out) {                 \
+        size_t i = 0, j = 0, k = 0;                                                                                    \
+        while (i < n_left && j < n_right) {                                                                            \
+            out[k++] = less(right[j], left[i]) ? right[j++] : left[i++];                                               \
+        }                                                                                                              \
+        memcpy(out + k, left + i, (n_left - i) * sizeof(type));                                                        \
+        memcpy(out + k + n_left - i, right + j, (n_right - j) * sizeof(type));                                         \
+    }                                                                                                                  \
+    void name##_stable_sort(type *data, type *tmp, size_t n) {                                                         \
+        if (n <= SORT_INSERTION_CUTOFF) {                                                                              \
+            name##_insertion_sort(data, n);                                                                            \
+            return;                                                                                                    \
+        }                                                                                                              \
+        size_t half = n / 2;                                                                                           \
+        name##_stable_sort(data, tmp, half);                                                                           \
+        name##_stable_sort(data + half, tmp + half, n - half);                                                         \
+        if (!less(data[half], data[half - 1])) {                                                                       \
+            return;                                                                                                    \
+        }                                                                                                              \
+        name##_merge(data, half, data + half, n - half, tmp);                                                          \
+        memcpy(data, tmp, n * sizeof(type));                                                                           \
+    }
+
+// least significant byte first radix sort on the unsigned 64 bits key(value), skipping the bytes every key shares,
+// stable, tmp being a scratch buffer of n elements
+#define RADIX_SORT(type, name, key)                                                                                    \
+    void name##_radix_sort(type *data, type *tmp, size_t n) {                                                          \
+        type *from = data, *to = tmp;                                                                                  \
+        for (unsigned shift = 0; shift < 64 && n > 0; shift += 8) {                                                    \
+            size_t offsets[257] = {0};                                                                                 \
+            for (size_t i = 0; i < n; ++i) {                                                                           \
+                offsets[((key(from[i]) >> shift) & 0xff) + 1]++;                                                       \
+            }                                                                                                          \
+            if (offsets[((key(from[0]) >> shift) & 0xff) + 1] == n) {                                                  \
+                continue;                                                                                              \
+            }                                                                                                          \
+            for (size_t b = 1; b < 257; ++b) {                                                                         \
+                offsets[b] += offsets[b - 1];                                                                          \
+            }                                                                                                          \
+            for (size_t i = 0; i < n; ++i) {                                                                           \
+                to[offsets[(key(from[i]) >> shift) & 0xff]++] = from[i];                                               \
+            }                                                                                                          \
+            type *swap = from;                                                                                         \
+            from = to;                                                                                                 \
+            to = swap;                                                                                                 \
+        }                                                                                                              \
+        if (from != data) {                                                                                            \
+            memcpy(data, from, n * sizeof(type));                                                                      \
+        }                                                                                                              \
+    }